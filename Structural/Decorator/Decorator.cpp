@@ -8,9 +8,42 @@
 *
 */
 
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <new>
+#include <random>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <memory>
+#include <memory_resource>
+#include <type_traits>
+#include <vector>
+
+/*
+* Part
+* identifies a base drink or an ingredient of a recipe; parts[] holds the
+* text and the price every class below uses
+*/
+enum Part : uint8_t { partWATER, partMILK, partCOFFEE, partSUGAR, partICECUBE };
+
+struct PartInfo {
+	std::string_view text;
+	unsigned int price;
+};
+
+constexpr PartInfo parts[] = {
+	{ " Water ", 1 },
+	{ " Milk ", 10 },
+	{ "+ Coffee ", 5 },
+	{ "+ Sugar ", 1 },
+	{ "+ Ice Cube ", 1 },
+};
 
 /*
 * Drink  ==>  Component
@@ -19,15 +52,87 @@
 */
 class Drink {
 public:
-	virtual std::string toString() const = 0;
+	// appends the description to the caller's buffer: linear in the length of
+	// the chain, and allocation-free once the buffer has the capacity
+	virtual void describeTo(std::string& buffer) const = 0;
 	virtual unsigned int getPrice() const = 0;
-	friend std::ostream &operator<<(std::ostream &out, const std::unique_ptr<Drink> &drink)
+	// appends the parts of the drink, base drink first
+	virtual void appendParts(std::vector<Part>& recipe) const = 0;
+
+	// one allocation: the returned string
+	std::string toString() const
 	{
-		return out << " [Component] : " << drink->toString();
+		std::string& buffer = scratchBuffer();
+		buffer.clear();
+		describeTo(buffer);
+		return buffer;
+	}
+
+	template <typename Deleter>
+	friend std::ostream &operator<<(std::ostream &out, const std::unique_ptr<Drink, Deleter> &drink)
+	{
+		std::string& buffer = scratchBuffer();
+		buffer.clear();
+		drink->describeTo(buffer);
+		return out << " [Component] : " << buffer;
 	}
 	virtual ~Drink(){}
+
+private:
+	// reused by toString() and operator<< of the thread
+	static std::string& scratchBuffer()
+	{
+		thread_local std::string buffer;
+		return buffer;
+	}
+};
+
+/*
+* DrinkDeleter
+* deleter of the drinks a chain owns: deletes a drink built on the heap,
+* destroys a drink built by makeDrink() and gives its memory back to the
+* resource it came from (a no-op for a DrinkArena, which owns the memory)
+* a std::unique_ptr<Coffee> converts to a DrinkPtr, so heap chains are
+* built as before
+*/
+struct DrinkDeleter {
+	DrinkDeleter() = default;
+	DrinkDeleter(std::pmr::memory_resource* resource, size_t size, size_t alignment)
+		: resource(resource), size(size), alignment(alignment) {}
+	template <typename T>
+	DrinkDeleter(const std::default_delete<T>&) {}
+
+	void operator()(Drink* drink) const
+	{
+		if (resource) {
+			drink->~Drink();
+			resource->deallocate(drink, size, alignment);
+		}
+		else {
+			delete drink;
+		}
+	}
+
+	std::pmr::memory_resource* resource = nullptr;	// null: built with new
+	size_t size = 0;
+	size_t alignment = 0;
 };
 
+using DrinkPtr = std::unique_ptr<Drink, DrinkDeleter>;
+
+/*
+* makeDrink
+* builds a drink in the memory of `resource`, released through it by the
+* DrinkDeleter: a DrinkArena builds its drinks with it, the benchmarks hand
+* it a counting resource
+*/
+template <typename T, typename... Args>
+std::unique_ptr<T, DrinkDeleter> makeDrink(std::pmr::memory_resource& resource, Args&&... args)
+{
+	void* place = resource.allocate(sizeof(T), alignof(T));
+	return std::unique_ptr<T, DrinkDeleter>(new (place) T(std::forward<Args>(args)...), DrinkDeleter(&resource, sizeof(T), alignof(T)));
+}
+
 /*
 * Water  ==>  Concrete Component
 * defines an object to which additional responsibilities
@@ -35,8 +140,9 @@ public:
 */
 class Water : public Drink {
 public:
-	std::string toString() const override {return " Water ";}
-	unsigned int getPrice() const override { return 1; }
+	void describeTo(std::string& buffer) const override { buffer += parts[partWATER].text; }
+	unsigned int getPrice() const override { return parts[partWATER].price; }
+	void appendParts(std::vector<Part>& recipe) const override { recipe.push_back(partWATER); }
 	~Water() {}
 };
 
@@ -47,8 +153,9 @@ public:
 */
 class Milk : public Drink {
 public:
-	std::string toString() const override { return " Milk "; }
-	unsigned int getPrice() const override { return 10; }
+	void describeTo(std::string& buffer) const override { buffer += parts[partMILK].text; }
+	unsigned int getPrice() const override { return parts[partMILK].price; }
+	void appendParts(std::vector<Part>& recipe) const override { recipe.push_back(partMILK); }
 	~Milk() {}
 };
 
@@ -59,21 +166,25 @@ public:
 */
 class Ingredient : public Drink {
 public:
-	explicit Ingredient(std::unique_ptr<Drink> drink)
+	explicit Ingredient(DrinkPtr drink)
 		: drink(std::move(drink)) {}
 
-	virtual std::string toString()  const override
+	virtual void describeTo(std::string& buffer) const override
 	{
-		return drink->toString();
+		drink->describeTo(buffer);
 	}
 	virtual unsigned int getPrice()  const override
 	{
 		return drink->getPrice();
 	}
+	virtual void appendParts(std::vector<Part>& recipe) const override
+	{
+		drink->appendParts(recipe);
+	}
 	virtual ~Ingredient() {}
 
 private:
-	std::unique_ptr<Drink> drink;
+	DrinkPtr drink;
 };
 
 /*
@@ -83,17 +194,24 @@ private:
 */
 class Coffee : public Ingredient {
 public:
-	explicit Coffee(std::unique_ptr<Drink> drink)
+	explicit Coffee(DrinkPtr drink)
 		: Ingredient(std::move(drink)) {}
 
-	std::string toString() const override
+	void describeTo(std::string& buffer) const override
 	{
-		return Ingredient::toString()+"+ Coffee ";
+		Ingredient::describeTo(buffer);
+		buffer += parts[partCOFFEE].text;
 	}
 
 	unsigned int getPrice()  const override
 	{
-		return Ingredient::getPrice() + 5;
+		return Ingredient::getPrice() + parts[partCOFFEE].price;
+	}
+
+	void appendParts(std::vector<Part>& recipe) const override
+	{
+		Ingredient::appendParts(recipe);
+		recipe.push_back(partCOFFEE);
 	}
 
 	~Coffee() {}
@@ -107,17 +225,24 @@ public:
 */
 class Sugar : public Ingredient {
 public:
-	explicit Sugar(std::unique_ptr<Drink> drink)
+	explicit Sugar(DrinkPtr drink)
 		: Ingredient(std::move(drink)) {}
 
-	std::string toString() const override
+	void describeTo(std::string& buffer) const override
 	{
-		return Ingredient::toString() + "+ Sugar ";
+		Ingredient::describeTo(buffer);
+		buffer += parts[partSUGAR].text;
 	}
 
 	unsigned int getPrice() const override
 	{
-		return Ingredient::getPrice() + 1;
+		return Ingredient::getPrice() + parts[partSUGAR].price;
+	}
+
+	void appendParts(std::vector<Part>& recipe) const override
+	{
+		Ingredient::appendParts(recipe);
+		recipe.push_back(partSUGAR);
 	}
 
 	~Sugar() {}
@@ -130,25 +255,751 @@ public:
 */
 class IceCube : public Ingredient {
 public:
-	explicit IceCube(std::unique_ptr<Drink> drink)
+	explicit IceCube(DrinkPtr drink)
 		: Ingredient(std::move(drink)) {}
 
-	std::string toString() const override
+	void describeTo(std::string& buffer) const override
 	{
-		return Ingredient::toString() + "+ Ice Cube ";
+		Ingredient::describeTo(buffer);
+		buffer += parts[partICECUBE].text;
 	}
 
 	unsigned int getPrice() const override
 	{
-		return Ingredient::getPrice() + 1;
+		return Ingredient::getPrice() + parts[partICECUBE].price;
+	}
+
+	void appendParts(std::vector<Part>& recipe) const override
+	{
+		Ingredient::appendParts(recipe);
+		recipe.push_back(partICECUBE);
 	}
 
 	~IceCube() {}
 };
 
+/*
+* Recipe  ==>  Concrete Component (sealed chain)
+* a decorator chain flattened by seal(): its parts in one contiguous array,
+* base drink first, and the total price summed once
+* getPrice() is O(1) and describeTo() one pass over the parts
+*/
+class Recipe : public Drink {
+public:
+	explicit Recipe(std::vector<Part> recipe)
+		: recipe(std::move(recipe))
+	{
+		for (Part part : this->recipe)
+		{
+			price += parts[part].price;
+			textLength += parts[part].text.size();
+		}
+	}
+
+	void describeTo(std::string& buffer) const override
+	{
+		buffer.reserve(buffer.size() + textLength);
+		for (Part part : recipe)
+		{
+			buffer += parts[part].text;
+		}
+	}
+
+	unsigned int getPrice() const override { return price; }
+
+	void appendParts(std::vector<Part>& out) const override
+	{
+		out.insert(out.end(), recipe.begin(), recipe.end());
+	}
+
+	const std::vector<Part>& getParts() const { return recipe; }
+
+	~Recipe() {}
+
+private:
+	std::vector<Part> recipe;
+	unsigned int price = 0;
+	size_t textLength = 0;
+};
+
+/*
+* FixedString
+* a string usable in constant expressions, so that the compiler can build
+* the recipe text of a statically composed drink
+*/
+template <size_t N>
+struct FixedString {
+	char text[N + 1] = {};
+
+	constexpr std::string_view view() const { return std::string_view(text, N); }
+};
+
+template <size_t N>
+constexpr FixedString<N> makeFixedString(std::string_view text)
+{
+	FixedString<N> result;
+	for (size_t i = 0; i < N; i++)
+	{
+		result.text[i] = text[i];
+	}
+	return result;
+}
+
+template <size_t A, size_t B>
+constexpr FixedString<A + B> operator+(const FixedString<A>& left, const FixedString<B>& right)
+{
+	FixedString<A + B> result;
+	for (size_t i = 0; i < A; i++)
+	{
+		result.text[i] = left.text[i];
+	}
+	for (size_t i = 0; i < B; i++)
+	{
+		result.text[A + i] = right.text[i];
+	}
+	return result;
+}
+
+template <Part part>
+constexpr FixedString<parts[part].text.size()> partText = makeFixedString<parts[part].text.size()>(parts[part].text);
+
+template <size_t N>
+constexpr std::array<Part, N + 1> appendPart(const std::array<Part, N>& recipe, Part part)
+{
+	std::array<Part, N + 1> result{};
+	for (size_t i = 0; i < N; i++)
+	{
+		result[i] = recipe[i];
+	}
+	result[N] = part;
+	return result;
+}
+
+/*
+* StaticDrink  ==>  Concrete Component (compile time)
+* StaticIngredient  ==>  Concrete Decorator (compile time)
+* decorators composed as types when the drink is known statically:
+* StaticCoffee<StaticSugar<StaticWater>> has its price, recipe text and
+* parts as compile-time constants, with no object, allocation or virtual call
+*/
+template <Part base>
+struct StaticDrink {
+	static constexpr unsigned int price = parts[base].price;
+	static constexpr auto recipe = partText<base>;
+	static constexpr std::array<Part, 1> recipeParts = { base };
+};
+
+template <Part part, typename Inner>
+struct StaticIngredient {
+	static constexpr unsigned int price = Inner::price + parts[part].price;
+	static constexpr auto recipe = Inner::recipe + partText<part>;
+	static constexpr auto recipeParts = appendPart(Inner::recipeParts, part);
+};
+
+using StaticWater = StaticDrink<partWATER>;
+using StaticMilk = StaticDrink<partMILK>;
+template <typename Inner> using StaticCoffee = StaticIngredient<partCOFFEE, Inner>;
+template <typename Inner> using StaticSugar = StaticIngredient<partSUGAR, Inner>;
+template <typename Inner> using StaticIceCube = StaticIngredient<partICECUBE, Inner>;
+
+using StaticIcedCoffee = StaticCoffee<StaticIceCube<StaticSugar<StaticWater>>>;
+static_assert(StaticIcedCoffee::price == 8, "Iced Coffee costs 8 $");
+static_assert(StaticIcedCoffee::recipe.view() == " Water + Sugar + Ice Cube + Coffee ", "recipe built at compile time");
+
+/*
+* Composed  ==>  Concrete Component
+* puts a statically composed drink behind the Drink interface, where
+* dynamic code expects one
+*/
+template <typename StaticType>
+class Composed : public Drink {
+public:
+	void describeTo(std::string& buffer) const override { buffer += StaticType::recipe.view(); }
+	unsigned int getPrice() const override { return StaticType::price; }
+	void appendParts(std::vector<Part>& recipe) const override
+	{
+		recipe.insert(recipe.end(), StaticType::recipeParts.begin(), StaticType::recipeParts.end());
+	}
+	~Composed() {}
+};
+
+/*
+* seal
+* flattens a drink (any chain of decorators) into a Recipe
+*/
+std::unique_ptr<Recipe> seal(const Drink& drink)
+{
+	std::vector<Part> recipe;
+	drink.appendParts(recipe);
+	return std::make_unique<Recipe>(std::move(recipe));
+}
+
+/*
+* OrderTotals
+* result of pricing an order
+*/
+struct OrderTotals {
+	size_t drinks;
+	unsigned long long price;
+};
+
+/*
+* orderThreads
+* threads used for an order of count drinks: none beyond the first below
+* minimumPerThread drinks each (0 threads: one per core)
+*/
+size_t orderThreads(size_t count, size_t threads, size_t minimumPerThread)
+{
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	return std::max<size_t>(1, std::min(threads, count / minimumPerThread));
+}
+
+/*
+* forEachSlice
+* runs work(thread, first, last) over [0, count) split in `threads` slices,
+* the first slice on the calling thread
+*/
+template <typename Work>
+void forEachSlice(size_t count, size_t threads, Work&& work)
+{
+	std::vector<std::thread> workers;
+	for (size_t t = 1; t < threads; t++)
+	{
+		workers.emplace_back([&, t]() { work(t, count * t / threads, count * (t + 1) / threads); });
+	}
+	work(0, 0, count / threads);
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+/*
+* priceDrinks
+* prices an order of any drinks through Drink::getPrice(), split across
+* threads when it is large
+*/
+OrderTotals priceDrinks(const Drink* const* drinks, size_t count, size_t threads = 0)
+{
+	threads = orderThreads(count, threads, 1 << 14);
+	std::vector<unsigned long long> sums(threads);
+	forEachSlice(count, threads, [&](size_t t, size_t first, size_t last) {
+		unsigned long long sum = 0;
+		for (size_t i = first; i < last; i++)
+		{
+			sum += drinks[i]->getPrice();
+		}
+		sums[t] = sum;
+	});
+	OrderTotals totals{ count, 0 };
+	for (unsigned long long sum : sums)
+	{
+		totals.price += sum;
+	}
+	return totals;
+}
+
+/*
+* Menu
+* the shapes (part sequences) an order can contain, each sealed once into a
+* Recipe; an order is then an array of shape ids, priced by counting the ids
+* of each shape and summing count x price once per shape
+*  - large orders are counted in slices on several threads
+*  - four interleaved counters per shape, so runs of one shape do not wait on
+*    the previous increment, and the final count x price sum is a plain loop
+*    over contiguous arrays that the compiler vectorizes
+*/
+class Menu {
+public:
+	// the shape id of drink, sealing it on first sight
+	uint32_t add(const Drink& drink)
+	{
+		std::vector<Part> recipe;
+		drink.appendParts(recipe);
+		auto found = shapes.find(recipe);
+		if (found != shapes.end()) {
+			return found->second;
+		}
+		const uint32_t shape = static_cast<uint32_t>(recipes.size());
+		shapes.emplace(recipe, shape);
+		recipes.push_back(std::make_unique<Recipe>(std::move(recipe)));
+		prices.push_back(recipes.back()->getPrice());
+		return shape;
+	}
+
+	const Recipe& recipe(uint32_t shape) const { return *recipes.at(shape); }
+
+	size_t size() const { return recipes.size(); }
+
+	OrderTotals priceOrder(const uint32_t* order, size_t count, size_t threads = 0) const
+	{
+		threads = orderThreads(count, threads, 1 << 16);
+		const size_t slots = prices.size() + 1;	// the last slot counts unknown ids
+		std::vector<unsigned long long> counts(threads * slots);
+		forEachSlice(count, threads, [&](size_t t, size_t first, size_t last) {
+			countShapes(order + first, last - first, &counts[t * slots]);
+		});
+
+		std::vector<unsigned long long> perShape(slots);
+		for (size_t t = 0; t < threads; t++)
+		{
+			for (size_t shape = 0; shape < slots; shape++)
+			{
+				perShape[shape] += counts[t * slots + shape];
+			}
+		}
+		if (perShape.back() != 0) {
+			std::cout << perShape.back() << " drinks of the order are not on the menu" << std::endl;
+			throw("drinks of the order are not on the menu");
+		}
+		OrderTotals totals{ count, 0 };
+		for (size_t shape = 0; shape < prices.size(); shape++)
+		{
+			totals.price += perShape[shape] * prices[shape];
+		}
+		return totals;
+	}
+
+private:
+	void countShapes(const uint32_t* order, size_t count, unsigned long long* perShape) const
+	{
+		const size_t slots = prices.size() + 1;
+		std::vector<unsigned long long> lanes(4 * slots);
+		auto slot = [&](uint32_t shape) { return std::min<size_t>(shape, slots - 1); };
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			lanes[slot(order[i])]++;
+			lanes[slots + slot(order[i + 1])]++;
+			lanes[2 * slots + slot(order[i + 2])]++;
+			lanes[3 * slots + slot(order[i + 3])]++;
+		}
+		for (; i < count; i++)
+		{
+			lanes[slot(order[i])]++;
+		}
+		for (size_t shape = 0; shape < slots; shape++)
+		{
+			perShape[shape] = lanes[shape] + lanes[slots + shape] + lanes[2 * slots + shape] + lanes[3 * slots + shape];
+		}
+	}
+
+	std::map<std::vector<Part>, uint32_t> shapes;
+	std::vector<std::unique_ptr<Recipe>> recipes;
+	std::vector<unsigned long long> prices;
+};
+
+/*
+* DrinkArena
+* builds drink chains in the contiguous blocks of a monotonic buffer: no
+* allocation per layer (one per block, the first block holds dozens of
+* layers), and all the memory is released at once with the arena;
+* the drinks made by an arena must be destroyed before it
+*/
+class DrinkArena {
+public:
+	explicit DrinkArena(size_t initialBytes = 4096, std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+		: memory(initialBytes, upstream) {}
+
+	DrinkArena(const DrinkArena&) = delete;
+	DrinkArena& operator=(const DrinkArena&) = delete;
+
+	template <typename T, typename... Args>
+	std::unique_ptr<T, DrinkDeleter> make(Args&&... args)
+	{
+		return makeDrink<T>(memory, std::forward<Args>(args)...);
+	}
+
+	std::pmr::memory_resource& resource() { return memory; }
+
+private:
+	std::pmr::monotonic_buffer_resource memory;
+};
+
+/*
+* CountingResource
+* memory resource counting the allocations it passes on to the default
+* one: the benchmarks hand it to what they measure, the rest of the program
+* allocates without any counter
+*/
+class CountingResource : public std::pmr::memory_resource {
+public:
+	size_t allocations() const { return allocationCount; }
+
+private:
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		allocationCount++;
+		return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* memory, size_t bytes, size_t alignment) override
+	{
+		std::pmr::new_delete_resource()->deallocate(memory, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+	size_t allocationCount = 0;
+};
+
+/*
+* makeChain
+* a decorator chain of `depth` ingredients over Water (Coffee, Sugar,
+* Ice Cube in turn), for the benchmarks
+*/
+std::unique_ptr<Drink> makeChain(size_t depth)
+{
+	std::unique_ptr<Drink> drink = std::make_unique<Water>();
+	for (size_t layer = 0; layer < depth; layer++)
+	{
+		switch (layer % 3)
+		{
+		case 0: drink = std::make_unique<Coffee>(std::move(drink)); break;
+		case 1: drink = std::make_unique<Sugar>(std::move(drink)); break;
+		default: drink = std::make_unique<IceCube>(std::move(drink)); break;
+		}
+	}
+	return drink;
+}
+
+DrinkPtr makeChain(size_t depth, std::pmr::memory_resource& resource)
+{
+	DrinkPtr drink = makeDrink<Water>(resource);
+	for (size_t layer = 0; layer < depth; layer++)
+	{
+		switch (layer % 3)
+		{
+		case 0: drink = makeDrink<Coffee>(resource, std::move(drink)); break;
+		case 1: drink = makeDrink<Sugar>(resource, std::move(drink)); break;
+		default: drink = makeDrink<IceCube>(resource, std::move(drink)); break;
+		}
+	}
+	return drink;
+}
+
+/*
+* benchmarkSeal
+* getPrice() and toString() of decorator chains of growing depth,
+* walked through the layers and sealed into a Recipe
+*/
+void benchmarkSeal()
+{
+	for (size_t depth : { 1, 4, 16, 64 })
+	{
+		std::unique_ptr<Drink> chain = makeChain(depth);
+		std::unique_ptr<Drink> sealed = seal(*chain);
+		const size_t calls = 20000000 / depth;
+		for (const Drink* drink : { chain.get(), sealed.get() })
+		{
+			unsigned long long total = 0;
+			auto start = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < calls; i++)
+			{
+				total += drink->getPrice();
+			}
+			const double priceTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+			size_t length = 0;
+			start = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < calls / 100; i++)
+			{
+				length += drink->toString().size();
+			}
+			const double textTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (calls / 100);
+			std::cout << "depth " << depth << (drink == chain.get() ? ", chain  : " : ", sealed : ")
+				<< "getPrice " << priceTime << " ns, toString " << textTime << " ns"
+				<< " (price " << total / calls << ", " << length / (calls / 100) << " characters)" << std::endl;
+		}
+	}
+}
 
-int main()
+/*
+* describeByLayers
+* what every toString() override used to do: each layer returns a new
+* string, the layer above appends its text to it (strings from resource)
+*/
+std::pmr::string describeByLayers(const std::vector<Part>& recipe, size_t layers, std::pmr::memory_resource* resource)
 {
+	if (layers == 1) {
+		return std::pmr::string(parts[recipe[0]].text, resource);
+	}
+	std::pmr::string text = describeByLayers(recipe, layers - 1, resource);
+	text += parts[recipe[layers - 1]].text;
+	return text;
+}
+
+/*
+* benchmarkDescribe
+* describing chains of growing depth: a string returned by every layer
+* (describeByLayers), toString(), and describeTo() into a buffer the caller reuses;
+* allocations are those of the layer strings, the toString() results that
+* outgrow the small-string buffer, and the growths of the reused buffer
+*/
+void benchmarkDescribe()
+{
+	for (size_t depth : { 1, 4, 16, 64, 256 })
+	{
+		std::unique_ptr<Drink> chain = makeChain(depth);
+		std::vector<Part> recipe;
+		chain->appendParts(recipe);
+		const size_t calls = 2000000 / depth;
+		std::string buffer;
+		size_t length = 0;
+		const size_t smallStringCapacity = std::string().capacity();
+		for (int mode = 0; mode < 3; mode++)
+		{
+			CountingResource layerStrings;
+			size_t heapResults = 0;
+			size_t bufferGrowths = 0;
+			auto start = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < calls; i++)
+			{
+				if (mode == 0) {
+					length += describeByLayers(recipe, recipe.size(), &layerStrings).size();
+				}
+				else if (mode == 1) {
+					const std::string text = chain->toString();
+					heapResults += (text.capacity() > smallStringCapacity);
+					length += text.size();
+				}
+				else {
+					const size_t capacity = buffer.capacity();
+					buffer.clear();
+					chain->describeTo(buffer);
+					bufferGrowths += (buffer.capacity() != capacity);
+					length += buffer.size();
+				}
+			}
+			const double time = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+			const double allocations = static_cast<double>(layerStrings.allocations() + heapResults + bufferGrowths) / calls;
+			std::cout << "depth " << depth << (mode == 0 ? ", string per layer : " : mode == 1 ? ", toString()       : " : ", describeTo()     : ")
+				<< time << " ns, " << allocations << " allocations per description" << std::endl;
+		}
+		if (length == 0) {
+			std::cout << std::endl;
+		}
+	}
+}
+
+/*
+* StaticChain
+* the static counterpart of makeChain(depth)
+*/
+template <size_t depth>
+struct StaticChain {
+	using Inner = typename StaticChain<depth - 1>::type;
+	using type = std::conditional_t<(depth - 1) % 3 == 0, StaticCoffee<Inner>,
+		std::conditional_t<(depth - 1) % 3 == 1, StaticSugar<Inner>, StaticIceCube<Inner>>>;
+};
+
+template <>
+struct StaticChain<0> {
+	using type = StaticWater;
+};
+
+/*
+* benchmarkStatic
+* getPrice() and describeTo() at depth 1 to 64: virtual Ingredient chain,
+* static composition behind the Drink interface (Composed), and the
+* compile-time constant itself
+*/
+template <size_t depth>
+void benchmarkStaticDepth()
+{
+	using Static = typename StaticChain<depth>::type;
+	std::unique_ptr<Drink> chain = makeChain(depth);
+	std::unique_ptr<Drink> composed = std::make_unique<Composed<Static>>();
+	if (chain->getPrice() != Static::price || chain->toString() != Static::recipe.view()) {
+		std::cout << "static and dynamic drinks differ at depth " << depth << std::endl;
+		throw("static and dynamic drinks differ");
+	}
+	const size_t calls = 10000000;
+	const std::vector<const Drink*> drinks = { chain.get(), composed.get() };
+	std::cout << "depth " << std::setw(2) << depth;
+	for (size_t which = 0; which < 2; which++)
+	{
+		const Drink* drink = drinks[which];
+		unsigned long long total = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < calls; i++)
+		{
+			total += drink->getPrice();
+		}
+		const double priceTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+		std::string buffer;
+		start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < calls / 100; i++)
+		{
+			buffer.clear();
+			drink->describeTo(buffer);
+		}
+		const double textTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (calls / 100);
+		std::cout << (which == 0 ? " | chain : " : " | Composed : ") << std::fixed << std::setprecision(1)
+			<< std::setw(6) << priceTime << " ns getPrice, " << std::setw(6) << textTime << " ns describeTo";
+		if (total != static_cast<unsigned long long>(Static::price) * calls) {
+			std::cout << " (wrong total)";
+		}
+	}
+	std::cout << " | constant : " << Static::price << " $, " << Static::recipe.view().size() << " characters" << std::endl;
+}
+
+void benchmarkStatic()
+{
+	benchmarkStaticDepth<1>();
+	benchmarkStaticDepth<2>();
+	benchmarkStaticDepth<4>();
+	benchmarkStaticDepth<8>();
+	benchmarkStaticDepth<16>();
+	benchmarkStaticDepth<32>();
+	benchmarkStaticDepth<64>();
+}
+
+/*
+* benchmarkArena
+* one million layers as chains of depth 4 to 64: allocations and time to
+* build, getPrice() walk and destruction, unique_ptr layering on the heap
+* (one allocation per layer) against one DrinkArena for all the chains
+* (one allocation per block); both counted by a CountingResource, the heap
+* chains built through it, the arena taking its blocks from it
+*/
+void benchmarkArena()
+{
+	using Clock = std::chrono::steady_clock;
+	auto milliseconds = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+	for (size_t depth : { 4, 16, 64 })
+	{
+		const size_t chainCount = 1000000 / depth;
+		for (bool useArena : { false, true })
+		{
+			CountingResource heap;
+			std::unique_ptr<DrinkArena> arena = useArena ? std::make_unique<DrinkArena>(1 << 20, &heap) : nullptr;
+			std::pmr::memory_resource& resource = useArena ? arena->resource() : heap;
+			std::vector<DrinkPtr> chains;
+			chains.reserve(chainCount);
+			auto start = Clock::now();
+			for (size_t i = 0; i < chainCount; i++)
+			{
+				chains.push_back(makeChain(depth, resource));
+			}
+			const double buildTime = milliseconds(start);
+			const size_t allocations = heap.allocations();
+
+			unsigned long long total = 0;
+			start = Clock::now();
+			for (int round = 0; round < 10; round++)
+			{
+				for (const DrinkPtr& chain : chains)
+				{
+					total += chain->getPrice();
+				}
+			}
+			const double walkTime = milliseconds(start) / 10;
+
+			start = Clock::now();
+			chains.clear();
+			arena.reset();
+			const double destroyTime = milliseconds(start);
+
+			std::cout << "depth " << std::setw(2) << depth << (useArena ? ", DrinkArena : " : ", unique_ptr : ")
+				<< std::setw(8) << allocations << " allocations, build " << std::fixed << std::setprecision(1) << std::setw(6) << buildTime
+				<< " ms, walk " << std::setw(6) << walkTime << " ms, destroy " << std::setw(6) << destroyTime << " ms"
+				<< " (total " << total / 10 << " $)" << std::endl;
+		}
+	}
+}
+
+/*
+* benchmarkOrders
+* an order of 10M drinks over a menu of 48 shapes (depth 1 to 16, the
+* popular ones ordered most): drinks priced per second through the
+* decorator chains, through sealed recipes, and through the Menu on
+* 1 and N threads
+*/
+void benchmarkOrders()
+{
+	std::vector<std::unique_ptr<Drink>> chains;
+	std::vector<std::unique_ptr<Drink>> sealed;
+	Menu menu;
+	for (size_t depth = 1; depth <= 16; depth++)
+	{
+		for (size_t variant = 0; variant < 3; variant++)
+		{
+			std::unique_ptr<Drink> drink = makeChain(depth + variant);
+			if (variant == 1) {
+				drink = std::make_unique<Sugar>(std::move(drink));
+			}
+			else if (variant == 2) {
+				drink = std::make_unique<Coffee>(std::make_unique<IceCube>(std::move(drink)));
+			}
+			if (menu.add(*drink) != chains.size()) {
+				continue;	// already on the menu
+			}
+			sealed.push_back(seal(*drink));
+			chains.push_back(std::move(drink));
+		}
+	}
+
+	const size_t orderSize = 10000000;
+	std::mt19937 generate(2019);
+	std::geometric_distribution<uint32_t> popularity(0.1);
+	std::vector<uint32_t> order(orderSize);
+	std::vector<const Drink*> chainOrder(orderSize);
+	std::vector<const Drink*> sealedOrder(orderSize);
+	for (size_t i = 0; i < orderSize; i++)
+	{
+		order[i] = std::min<uint32_t>(popularity(generate), static_cast<uint32_t>(menu.size() - 1));
+		chainOrder[i] = chains[order[i]].get();
+		sealedOrder[i] = sealed[order[i]].get();
+	}
+
+	const size_t threads = std::max(4u, std::thread::hardware_concurrency());
+	auto report = [&](const char* name, auto&& price) {
+		auto start = std::chrono::steady_clock::now();
+		OrderTotals totals = price();
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << name << std::setw(12) << static_cast<size_t>(totals.drinks / seconds) << " drinks priced per second (total "
+			<< totals.price << " $)" << std::endl;
+	};
+	std::cout << menu.size() << " shapes, order of " << orderSize << " drinks" << std::endl;
+	report("chains, getPrice()         1 thread  : ", [&]() { return priceDrinks(chainOrder.data(), orderSize, 1); });
+	report("sealed, getPrice()         1 thread  : ", [&]() { return priceDrinks(sealedOrder.data(), orderSize, 1); });
+	report("Menu, shape ids            1 thread  : ", [&]() { return menu.priceOrder(order.data(), orderSize, 1); });
+	std::cout << threads << " threads" << std::endl;
+	report("chains, getPrice()         N threads : ", [&]() { return priceDrinks(chainOrder.data(), orderSize, threads); });
+	report("sealed, getPrice()         N threads : ", [&]() { return priceDrinks(sealedOrder.data(), orderSize, threads); });
+	report("Menu, shape ids            N threads : ", [&]() { return menu.priceOrder(order.data(), orderSize, threads); });
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && std::string(argv[1]) == "--bench-orders")
+	{
+		benchmarkOrders();
+		return 0;
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench-arena")
+	{
+		benchmarkArena();
+		return 0;
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench-static")
+	{
+		benchmarkStatic();
+		return 0;
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench-describe")
+	{
+		benchmarkDescribe();
+		return 0;
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench-seal")
+	{
+		benchmarkSeal();
+		return 0;
+	}
+
 	std::unique_ptr<Drink> icedCoffee = std::make_unique<Coffee>(std::make_unique<IceCube>
 								(std::make_unique<Sugar>
 								(std::make_unique<Water>())));
@@ -160,6 +1011,19 @@ int main()
 	std::cout << "recipe of Cafe Latte " << cafeLatte << std::endl;
 	std::cout << "price : " << cafeLatte->getPrice() << " $" << std::endl;
 
+	std::unique_ptr<Drink> sealedLatte = seal(*cafeLatte);
+	std::cout << "sealed Cafe Latte " << sealedLatte << std::endl;
+	std::cout << "price : " << sealedLatte->getPrice() << " $" << std::endl;
+
+	DrinkArena arena;
+	DrinkPtr arenaLatte = arena.make<Coffee>(arena.make<Sugar>(arena.make<Milk>()));
+	std::cout << "Cafe Latte built in one arena " << arenaLatte << std::endl;
+	std::cout << "price : " << arenaLatte->getPrice() << " $" << std::endl;
+
+	std::unique_ptr<Drink> staticIcedCoffee = std::make_unique<Composed<StaticIcedCoffee>>();
+	std::cout << "static Iced Coffee " << staticIcedCoffee << std::endl;
+	std::cout << "price : " << StaticIcedCoffee::price << " $ (compile time)" << std::endl;
+
 	system("pause");
 	return 0;
 }
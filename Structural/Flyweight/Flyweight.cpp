@@ -8,31 +8,263 @@
 *
 */
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX		// keeps std::min / std::max usable
 #include <Windows.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <numeric>
 #include <random>
 #include <string>
-
-HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 enum Color
 {
-	colorBLUE = FOREGROUND_BLUE | FOREGROUND_GREEN | FOREGROUND_INTENSITY | BACKGROUND_BLUE,
-	colorGREEN = FOREGROUND_GREEN | FOREGROUND_INTENSITY | BACKGROUND_BLUE | BACKGROUND_GREEN,
-	colorRED = FOREGROUND_RED | FOREGROUND_INTENSITY | BACKGROUND_BLUE | BACKGROUND_RED,
-	colorDEFAULT = FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE
+	colorBLUE,
+	colorGREEN,
+	colorRED,
+	colorDEFAULT
+};
+
+/*
+ * ansiColor
+ * ANSI escape sequence matching the old console attributes of each color
+ * (bright foreground over a tinted background)
+ */
+const char* ansiColor(const Color& color)
+{
+	switch (color)
+	{
+	case colorBLUE:
+		return "\x1b[96;44m";		// bright cyan on blue
+	case colorGREEN:
+		return "\x1b[92;46m";		// bright green on cyan
+	case colorRED:
+		return "\x1b[91;45m";		// bright red on magenta
+	default:
+		return "\x1b[0m";
+	}
+}
+
+/*
+ * Weight
+ * a terminal has a single font size: the point size of a glyph is rendered
+ * as the closest attribute it has, faint below 10 points and bold from 14
+ */
+enum Weight
+{
+	weightFAINT,
+	weightNORMAL,
+	weightBOLD
 };
 
-int generateRandomNumber(int min, int max) 
+constexpr Weight weightOf(const size_t& pointSize)
 {
-	std::random_device random;
-	std::mt19937 generate(random());
-	std::uniform_int_distribution<> distribution(min, max);	// distribution in range [min, max]
-	return distribution(generate);
+	return (pointSize < 10) ? weightFAINT : (pointSize < 14) ? weightNORMAL : weightBOLD;
 }
 
+const char* ansiWeight(const Weight& weight)
+{
+	switch (weight)
+	{
+	case weightFAINT:
+		return "\x1b[22;2m";
+	case weightBOLD:
+		return "\x1b[22;1m";
+	default:
+		return "\x1b[22m";
+	}
+}
+
+// dense key space of the flyweights: one slot per (symbol, color index)
+constexpr size_t symbolCount = 256;
+constexpr size_t colorCount = 3;
+constexpr Color palette[colorCount] = { colorBLUE, colorGREEN, colorRED };
+
+constexpr size_t slotIndex(const unsigned char& symbol, const unsigned char& indexColor)
+{
+	return symbol * colorCount + indexColor;
+}
+
+/*
+ * RandomGenerator
+ * one std::mt19937 per thread, seeded once when the thread first draws
+ * (from std::random_device, or from a fixed seed after setSeed() so that
+ * benchmark runs are reproducible)
+ */
+class RandomGenerator {
+public:
+	// deterministic mode: call before starting worker threads, each thread
+	// then derives its engine seed from (seed, order of first use)
+	static void setSeed(uint32_t seed)
+	{
+		fixedSeed = seed;
+		threadIndex = 0;
+		deterministic = true;
+		engine().seed(makeSeed());
+	}
+
+	static int next(int min, int max)
+	{
+		std::uniform_int_distribution<> distribution(min, max);	// distribution in range [min, max]
+		return distribution(engine());
+	}
+
+	// batch API: fills [first, last) with values in range [min, max] in one call
+	template <typename T>
+	static void fill(T* first, T* last, int min, int max)
+	{
+		std::mt19937& generate = engine();
+		std::uniform_int_distribution<> distribution(min, max);
+		for (; first != last; ++first)
+		{
+			*first = static_cast<T>(distribution(generate));
+		}
+	}
+
+private:
+	static std::mt19937& engine()
+	{
+		thread_local std::mt19937 generate(makeSeed());
+		return generate;
+	}
+
+	static std::seed_seq::result_type makeSeed()
+	{
+		if (!deterministic) {
+			std::random_device random;
+			return random();
+		}
+		std::seed_seq sequence{ fixedSeed.load(), threadIndex++ };
+		std::seed_seq::result_type seed;
+		sequence.generate(&seed, &seed + 1);
+		return seed;
+	}
+
+	static inline std::atomic<bool> deterministic{ false };
+	static inline std::atomic<uint32_t> fixedSeed{ 0 };
+	static inline std::atomic<uint32_t> threadIndex{ 0 };
+};
+
+/*
+ * AnsiRenderer
+ * portable rendering back end: glyphs are written into one output buffer,
+ * an escape sequence is emitted only when the color or the weight (point
+ * size) changes between two consecutive glyphs, and the buffer reaches the stream once per flush()
+ * (end of frame or document) or when it grows past flushThreshold
+ * a renderer built without a stream keeps its frame in memory until takeFrame()
+ */
+class AnsiRenderer {
+public:
+	explicit AnsiRenderer(std::ostream& out, size_t flushThreshold = 1 << 20) :
+		out(&out), flushThreshold(flushThreshold)
+	{
+		buffer.reserve(flushThreshold + 64);
+	}
+
+	AnsiRenderer() :
+		out(nullptr), flushThreshold(SIZE_MAX) {}
+
+	~AnsiRenderer()
+	{
+		if (out) {
+			flush();
+		}
+	}
+
+	void write(const Color& color, const size_t& pointSize, const char& symbol)
+	{
+		setStyle(color, weightOf(pointSize));
+		buffer += symbol;
+		if (buffer.size() >= flushThreshold) {
+			writeBuffer();
+		}
+	}
+
+	void write(const Color& color, const std::string& text)
+	{
+		setStyle(color, weightNORMAL);
+		buffer += text;
+		if (buffer.size() >= flushThreshold) {
+			writeBuffer();
+		}
+	}
+
+	// restores the default color and flushes the whole frame at once
+	void flush()
+	{
+		setStyle(colorDEFAULT, weightNORMAL);
+		writeBuffer();
+		if (out) {
+			out->flush();
+		}
+	}
+
+	// in-memory renderer: restores the default color and hands the frame over
+	std::string takeFrame()
+	{
+		setStyle(colorDEFAULT, weightNORMAL);
+		std::string frame;
+		frame.swap(buffer);
+		return frame;
+	}
+
+private:
+	void setStyle(const Color& color, const Weight& weight)
+	{
+		if (color != current) {
+			buffer += ansiColor(color);
+			current = color;
+			if (color == colorDEFAULT) {
+				currentWeight = weightNORMAL;	// the reset sequence also resets the weight
+			}
+		}
+		if (weight != currentWeight) {
+			buffer += ansiWeight(weight);
+			currentWeight = weight;
+		}
+	}
+
+	void writeBuffer()
+	{
+		if (out) {
+			out->write(buffer.data(), buffer.size());
+			buffer.clear();
+		}
+	}
+
+	std::ostream* out;
+	size_t flushThreshold;
+	std::string buffer;
+	Color current = colorDEFAULT;
+	Weight currentWeight = weightNORMAL;
+};
+
 /*
  * Character  ==>  Flyweight
  * declares an interface through which flyweights can receive
@@ -41,7 +273,7 @@ int generateRandomNumber(int min, int max)
 class Character {
 public:
 	virtual ~Character() { /* ... */ }
-	virtual void display(const size_t& size) = 0;
+	virtual void display(const size_t& size, AnsiRenderer& renderer) const = 0;
 };
 
 /*
@@ -53,15 +285,36 @@ public:
 	explicit Number(size_t intrinsic_state) :
 		state(intrinsic_state) {}
 
-	void display(const size_t& size)  override
+	void display(const size_t& size, AnsiRenderer& renderer) const override
 	{
-		std::cout << "Unshared Number with state " << state << size <<std::endl;
+		renderer.write(colorDEFAULT, "Unshared Number with state " + std::to_string(state) + std::to_string(size) + "\n");
 	}
 
 private:
 	size_t state;
 };
 
+/*
+ * UnsharedCharacter ==> UnsharedConcreteFlyweight
+ * a glyph object carrying all of its state, one per character:
+ * the baseline the shared flyweights are measured against
+ */
+class UnsharedCharacter : public Character {
+public:
+	UnsharedCharacter(const Color& color, const char& symbol, const size_t& pointSize) :
+		pointSize(pointSize), symbol(symbol), color(color) {}
+
+	// every state of the glyph is its own, the point size included
+	void display(const size_t& /*size*/, AnsiRenderer& renderer) const override
+	{
+		renderer.write(color, pointSize, symbol);
+	}
+private:
+	size_t pointSize;
+	char symbol;
+	Color color;
+};
+
 /*
  * CharacterBlue ==> ConcreteFlyweight
  * implements the Flyweight interface and adds storage
@@ -72,19 +325,15 @@ public:
 	CharacterBlue(const Color& color, const char& symbol) :
 		symbol(symbol),color(color) 
 	{
-		std::cout << "create new symbol " << symbol << "  ";
+		std::clog << "create new symbol " << symbol << "  ";
 	}
 
-	void display(const size_t& size) override
+	// the point size is extrinsic: it is read, never stored in the shared flyweight
+	void display(const size_t& size, AnsiRenderer& renderer) const override
 	{
-		pointSize = size;
-		SetConsoleTextAttribute(hConsole, color);
-		std::cout << "symbol " << symbol ;
-		SetConsoleTextAttribute(hConsole, colorDEFAULT);
-		std::cout << " with color Blue " << " (pointsize " << pointSize << " )" << std::endl;
+		renderer.write(color, size, symbol);
 	}
 private:
-	size_t pointSize = 0;
 	char symbol;
 	Color color;
 	//other Data width / height / ascent
@@ -100,19 +349,15 @@ public:
 	CharacterGreen(const Color& color, const char& symbol) :
 		symbol(symbol), color(color) 
 	{
-		std::cout << "create new symbol " << symbol << "  ";
+		std::clog << "create new symbol " << symbol << "  ";
 	}
 
-	void display(const size_t& size)  override
+	// the point size is extrinsic: it is read, never stored in the shared flyweight
+	void display(const size_t& size, AnsiRenderer& renderer) const override
 	{
-		pointSize = size;
-		SetConsoleTextAttribute(hConsole, color);
-		std::cout << "symbol " << symbol ;
-		SetConsoleTextAttribute(hConsole, colorDEFAULT);
-		std::cout << " with color Green " << " (pointsize " << pointSize << " )" << std::endl;
+		renderer.write(color, size, symbol);
 	}
 private:
-	size_t pointSize = 0;
 	char symbol;
 	Color color;
 	//other Data width / height / ascent
@@ -128,89 +373,1016 @@ public:
 	CharacterRed(const Color& color, const char& symbol) :
 		symbol(symbol), color(color) 
 	{
-		std::cout << "create new symbol " << symbol << "  ";
+		std::clog << "create new symbol " << symbol << "  ";
 	}
 
-	void display(const size_t& size)  override
+	// the point size is extrinsic: it is read, never stored in the shared flyweight
+	void display(const size_t& size, AnsiRenderer& renderer) const override
 	{
-		pointSize = size;
-		SetConsoleTextAttribute(hConsole, color);
-		std::cout << "symbol " << symbol ;
-		SetConsoleTextAttribute(hConsole, colorDEFAULT);
-		std::cout << " with color Red " << " (pointsize " << pointSize << " )" << std::endl;
+		renderer.write(color, size, symbol);
 	}
 private:
-	size_t pointSize = 0;
 	char symbol;
 	Color color;
 	//other Data width / height / ascent
 };
 
+/*
+ * createCharacter
+ * builds the concrete flyweight for a color index (0 Blue, 1 Green, 2 Red)
+ */
+std::shared_ptr<Character> createCharacter(const char& symbol, int indexColor)
+{
+	switch (indexColor)
+	{
+	case 0:
+		return std::make_shared<CharacterBlue>(colorBLUE, symbol);
+	case 1:
+		return std::make_shared<CharacterGreen>(colorGREEN, symbol);
+	case 2:
+		return std::make_shared<CharacterRed>(colorRED, symbol);
+	default:
+		std::cout << "Not Implemented" << std::endl;
+		throw("Not Implemented");
+	}
+}
+
 /*
  * CharacterFactory ==> FlyweightFactory
  * creates and manages flyweight objects and ensures
  * that flyweights are shared properly
+ * the pool is a preallocated symbolCount x colorCount slot table,
+ * so a lookup is one indexed load: no tree walk and no node allocation
  */
 class CharacterFactory {
 public:
 
 	std::shared_ptr<Character> getFlyweight(const char& symbol)
 	{
-		std::shared_ptr<Character> character = nullptr;
-		int indexColor = generateRandomNumber(0,2);							// distribution in range [0, 2]
+		return getFlyweight(symbol, RandomGenerator::next(0, colorCount - 1));	// distribution in range [0, 2]
+	}
+
+	std::shared_ptr<Character> getFlyweight(const char& symbol, int indexColor)
+	{
+		if (static_cast<size_t>(indexColor) >= colorCount) {
+			std::cout << "Not Implemented" << std::endl;
+			throw("Not Implemented");
+		}
+		return getFlyweightAt(slotIndex(symbol, indexColor));
+	}
+
+	// slot = slotIndex(symbol, indexColor), already validated by the caller
+	const std::shared_ptr<Character>& getFlyweightAt(const size_t& slot)
+	{
+		std::shared_ptr<Character>& character = characters[slot];
+		if (!character) {
+			character = createCharacter(static_cast<char>(slot / colorCount), slot % colorCount);
+		}
+		return character;
+	}
+
+private:
+	std::array<std::shared_ptr<Character>, symbolCount * colorCount> characters;
+};
+
+/*
+ * MapCharacterFactory ==> FlyweightFactory
+ * the original std::map pool (find + operator[] : two tree walks per lookup),
+ * kept as the reference for benchmarkLookup()
+ */
+class MapCharacterFactory {
+public:
+
+	std::shared_ptr<Character> getFlyweight(const char& symbol)
+	{
+		return getFlyweight(symbol, RandomGenerator::next(0, colorCount - 1));	// distribution in range [0, 2]
+	}
+
+	std::shared_ptr<Character> getFlyweight(const char& symbol, int indexColor)
+	{
 		std::pair<char, int> key = std::make_pair(symbol, indexColor);
 
 		if (characters.find(key) != characters.end()) {
 			return characters[key];
 		}
-		switch (indexColor)
-		{
-		case 0:
-			character = std::make_shared<CharacterBlue>(colorBLUE, symbol);
-			break;
-		case 1:
-			character = std::make_shared<CharacterGreen>(colorGREEN, symbol);
-			break;
-		case 2:
-			character = std::make_shared<CharacterRed>(colorRED, symbol);
-			break;
-		default:
+		std::shared_ptr<Character> character = createCharacter(symbol, indexColor);
+		characters.insert(std::pair <std::pair<char, int> , std::shared_ptr<Character>>(key, character));
+		return character;
+	}
+
+private:
+	std::map<std::pair<char, int>, std::shared_ptr<Character>> characters;
+};
+
+/*
+ * ConcurrentCharacterFactory ==> FlyweightFactory
+ * the slot table of CharacterFactory, shared by many rendering threads:
+ * reading a published flyweight is one acquire load and takes no lock,
+ * a missing glyph is interned under a mutex so it is constructed exactly once
+ * flyweights are handed out by reference (slots never change once published),
+ * so readers do not contend on the shared_ptr reference count either
+ */
+class ConcurrentCharacterFactory {
+public:
+
+	const std::shared_ptr<Character>& getFlyweight(const char& symbol)
+	{
+		return getFlyweight(symbol, RandomGenerator::next(0, colorCount - 1));	// distribution in range [0, 2]
+	}
+
+	const std::shared_ptr<Character>& getFlyweight(const char& symbol, int indexColor)
+	{
+		if (static_cast<size_t>(indexColor) >= colorCount) {
 			std::cout << "Not Implemented" << std::endl;
 			throw("Not Implemented");
 		}
-		characters.insert(std::pair <std::pair<char, int> , std::shared_ptr<Character>>(key, character));
-		return character;
+		return getFlyweightAt(slotIndex(symbol, indexColor));
+	}
+
+	// slot = slotIndex(symbol, indexColor), already validated by the caller
+	const std::shared_ptr<Character>& getFlyweightAt(const size_t& slot)
+	{
+		if (!published[slot].load(std::memory_order_acquire)) {
+			intern(slot);
+		}
+		return characters[slot];
+	}
+
+private:
+	void intern(const size_t& slot)
+	{
+		std::lock_guard<std::mutex> lock(internMutex);
+		if (!published[slot].load(std::memory_order_relaxed)) {	// another thread may have won the race
+			characters[slot] = createCharacter(static_cast<char>(slot / colorCount), slot % colorCount);
+			published[slot].store(true, std::memory_order_release);
+		}
+	}
+
+	std::array<std::shared_ptr<Character>, symbolCount * colorCount> characters;
+	std::array<std::atomic<bool>, symbolCount * colorCount> published{};
+	std::mutex internMutex;
+};
+
+/*
+ * GlyphData
+ * intrinsic state of a value-type flyweight: the color is plain data
+ * instead of a CharacterBlue / CharacterGreen / CharacterRed subclass
+ */
+struct GlyphData {
+	char symbol;
+	Color color;
+	//other Data width / height / ascent
+};
+
+/*
+ * Glyph ==> Flyweight (value type)
+ * trivially copyable handle on the shared intrinsic state: copying it
+ * touches no reference count and display() is statically dispatched
+ */
+class Glyph {
+public:
+	explicit Glyph(const GlyphData* data) : data(data) {}
+
+	void display(const size_t& size, AnsiRenderer& renderer) const
+	{
+		renderer.write(data->color, size, data->symbol);
+	}
+
+private:
+	const GlyphData* data;
+};
+
+static_assert(std::is_trivially_copyable<Glyph>::value, "Glyph must stay a plain handle");
+
+/*
+ * GlyphFactory ==> FlyweightFactory
+ * the intrinsic state of every (symbol, color) is built once up front,
+ * so a lookup is an address computation, and the table being immutable
+ * afterwards, it can be shared by any number of threads
+ */
+class GlyphFactory {
+public:
+	GlyphFactory()
+	{
+		for (size_t slot = 0; slot < glyphs.size(); slot++)
+		{
+			glyphs[slot] = GlyphData{ static_cast<char>(slot / colorCount), palette[slot % colorCount] };
+		}
+	}
+
+	Glyph getFlyweight(const char& symbol) const
+	{
+		return getFlyweight(symbol, RandomGenerator::next(0, colorCount - 1));	// distribution in range [0, 2]
+	}
+
+	Glyph getFlyweight(const char& symbol, int indexColor) const
+	{
+		if (static_cast<size_t>(indexColor) >= colorCount) {
+			std::cout << "Not Implemented" << std::endl;
+			throw("Not Implemented");
+		}
+		return getFlyweightAt(slotIndex(symbol, indexColor));
+	}
+
+	Glyph getFlyweightAt(const size_t& slot) const { return Glyph(&glyphs[slot]); }
+
+private:
+	std::array<GlyphData, symbolCount * colorCount> glyphs;
+};
+
+/*
+ * Document ==> Client
+ * keeps the extrinsic state of every glyph in columns (structure of arrays):
+ * symbol, color index and point size; flyweights never hold extrinsic state,
+ * and a whole range of glyphs is resolved and rendered in one pass
+ * (the columns are allocated from `resource`)
+ */
+class Document {
+public:
+	explicit Document(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+		symbols(resource), colors(resource), pointSizes(resource) {}
+
+	size_t size() const { return symbols.size(); }
+
+	void append(const char& symbol, int indexColor, uint32_t pointSize)
+	{
+		if (static_cast<size_t>(indexColor) >= colorCount) {
+			std::cout << "Not Implemented" << std::endl;
+			throw("Not Implemented");
+		}
+		symbols.push_back(static_cast<unsigned char>(symbol));
+		colors.push_back(static_cast<unsigned char>(indexColor));
+		pointSizes.push_back(pointSize);
+	}
+
+	void reserve(size_t count)
+	{
+		symbols.reserve(count);
+		colors.reserve(count);
+		pointSizes.reserve(count);
+	}
+
+	// appends `count` random lowercase letters with random colors and increasing point sizes
+	void appendRandom(size_t count, uint32_t firstPointSize)
+	{
+		const size_t first = size();
+		symbols.resize(first + count);
+		colors.resize(first + count);
+		pointSizes.resize(first + count);
+		RandomGenerator::fill(symbols.data() + first, symbols.data() + symbols.size(), 'a', 'z');
+		RandomGenerator::fill(colors.data() + first, colors.data() + colors.size(), 0, colorCount - 1);
+		std::iota(pointSizes.begin() + first, pointSizes.end(), firstPointSize);
+	}
+
+	const unsigned char* symbolData() const { return symbols.data(); }
+	const unsigned char* colorData() const { return colors.data(); }
+	const uint32_t* pointSizeData() const { return pointSizes.data(); }
+
+	// appends a text with random colors and increasing point sizes
+	void appendText(const std::string& text, uint32_t firstPointSize)
+	{
+		const size_t first = size();
+		symbols.insert(symbols.end(), text.begin(), text.end());
+		colors.resize(symbols.size());
+		pointSizes.resize(symbols.size());
+		RandomGenerator::fill(colors.data() + first, colors.data() + colors.size(), 0, colorCount - 1);
+		std::iota(pointSizes.begin() + first, pointSizes.end(), firstPointSize);
+	}
+
+	template <typename Factory>
+	void render(Factory& factory, AnsiRenderer& renderer, size_t first, size_t last) const
+	{
+		constexpr size_t blockSize = 512;
+		std::array<uint16_t, blockSize> slots;
+		const unsigned char* symbol = symbols.data();
+		const unsigned char* color = colors.data();
+		const uint32_t* pointSize = pointSizes.data();
+
+		for (size_t block = first; block < last; block += blockSize)
+		{
+			const size_t count = std::min(blockSize, last - block);
+			// branch-free arithmetic over contiguous columns: vectorized by the compiler
+			for (size_t i = 0; i < count; i++)
+			{
+				slots[i] = static_cast<uint16_t>(symbol[block + i] * colorCount + color[block + i]);
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				factory.getFlyweightAt(slots[i])->display(pointSize[block + i], renderer);
+			}
+		}
+	}
+
+private:
+	std::pmr::vector<unsigned char> symbols;
+	std::pmr::vector<unsigned char> colors;
+	std::pmr::vector<uint32_t> pointSizes;
+};
+
+/*
+ * DocumentStream
+ * streams a file to the flyweight resolver one window at a time, without
+ * copying it into a std::string: on POSIX each window is memory-mapped and
+ * unmapped before the next one, otherwise (or when the file cannot be mapped,
+ * e.g. a pipe) it is read into one fixed buffer, so peak memory stays at one
+ * window whatever the size of the file
+ */
+class DocumentStream {
+public:
+	explicit DocumentStream(const std::string& path, size_t windowSize = 64 << 20) :
+		windowSize(windowSize)
+	{
+#if defined(__unix__) || defined(__APPLE__)
+		file = ::open(path.c_str(), O_RDONLY);
+		struct stat status;
+		if (file >= 0 && ::fstat(file, &status) == 0 && S_ISREG(status.st_mode)) {
+			fileSize = static_cast<uint64_t>(status.st_size);
+			const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+			this->windowSize = std::max(page, windowSize / page * page);	// mmap offsets are page aligned
+			mappable = true;
+		}
+#else
+		input.open(path, std::ios::binary);
+#endif
+	}
+
+	~DocumentStream()
+	{
+#if defined(__unix__) || defined(__APPLE__)
+		if (file >= 0) {
+			::close(file);
+		}
+#endif
+	}
+
+	DocumentStream(const DocumentStream&) = delete;
+	DocumentStream& operator=(const DocumentStream&) = delete;
+
+	bool isOpen() const
+	{
+#if defined(__unix__) || defined(__APPLE__)
+		return file >= 0;
+#else
+		return input.is_open();
+#endif
+	}
+
+	// calls consume(const char* data, size_t size) once per window, in file order
+	template <typename Consumer>
+	void forEachChunk(Consumer&& consume)
+	{
+#if defined(__unix__) || defined(__APPLE__)
+		if (mappable) {
+			for (uint64_t offset = 0; offset < fileSize; offset += windowSize)
+			{
+				const size_t length = static_cast<size_t>(std::min<uint64_t>(windowSize, fileSize - offset));
+				void* window = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file, static_cast<off_t>(offset));
+				if (window == MAP_FAILED) {
+					::lseek(file, static_cast<off_t>(offset), SEEK_SET);	// finish with plain reads
+					break;
+				}
+				::madvise(window, length, MADV_SEQUENTIAL);
+				consume(static_cast<const char*>(window), length);
+				::munmap(window, length);
+				if (offset + length == fileSize) {
+					return;
+				}
+			}
+		}
+		std::vector<char> buffer(std::min<size_t>(windowSize, 1 << 20));
+		ssize_t count;
+		while ((count = ::read(file, buffer.data(), buffer.size())) > 0)
+		{
+			consume(static_cast<const char*>(buffer.data()), static_cast<size_t>(count));
+		}
+#else
+		std::vector<char> buffer(std::min<size_t>(windowSize, 1 << 20));
+		while (input.read(buffer.data(), buffer.size()) || input.gcount() > 0)
+		{
+			consume(static_cast<const char*>(buffer.data()), static_cast<size_t>(input.gcount()));
+		}
+#endif
+	}
+
+private:
+	size_t windowSize;
+#if defined(__unix__) || defined(__APPLE__)
+	int file = -1;
+	uint64_t fileSize = 0;
+	bool mappable = false;
+#else
+	std::ifstream input;
+#endif
+};
+
+/*
+ * ParallelRenderer
+ * rendering pipeline over one shared ConcurrentCharacterFactory:
+ *  1. the document is cut into chunks of chunkSize glyphs
+ *  2. worker threads resolve and render each chunk into its own frame
+ *  3. the calling thread writes the frames to the stream in document order
+ * at most 2 x threadCount frames are in flight, so memory stays bounded
+ */
+class ParallelRenderer {
+public:
+	explicit ParallelRenderer(ConcurrentCharacterFactory& factory, size_t threadCount = std::thread::hardware_concurrency(), size_t chunkSize = 1 << 20) :
+		factory(factory), threadCount(std::max<size_t>(1, threadCount)), chunkSize(std::max<size_t>(1, chunkSize)) {}
+
+	// renders data[0, size) whose first glyph has point size firstPointSize
+	void render(const char* data, size_t size, std::ostream& out, size_t firstPointSize = 11)
+	{
+		const size_t chunkCount = (size + chunkSize - 1) / chunkSize;
+		const size_t window = 2 * threadCount;
+		std::vector<std::string> frames(window);
+		std::vector<char> ready(window, 0);
+		std::mutex mutex;
+		std::condition_variable changed;
+		size_t nextChunk = 0;
+		size_t written = 0;
+
+		auto worker = [&]() {
+			for (;;)
+			{
+				size_t chunk;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					changed.wait(lock, [&]() { return nextChunk == chunkCount || nextChunk < written + window; });
+					if (nextChunk == chunkCount) {
+						return;
+					}
+					chunk = nextChunk++;
+				}
+				AnsiRenderer renderer;
+				const size_t first = chunk * chunkSize;
+				const size_t last = std::min(size, first + chunkSize);
+				for (size_t i = first; i < last; i++)
+				{
+					factory.getFlyweight(data[i])->display(firstPointSize + i, renderer);
+				}
+				std::string frame = renderer.takeFrame();
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					frames[chunk % window] = std::move(frame);
+					ready[chunk % window] = 1;
+				}
+				changed.notify_all();
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (size_t t = 0; t < std::min(threadCount, chunkCount); t++)
+		{
+			workers.emplace_back(worker);
+		}
+		for (size_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			std::string frame;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [&]() { return ready[chunk % window] != 0; });
+				frame = std::move(frames[chunk % window]);
+				ready[chunk % window] = 0;
+			}
+			out.write(frame.data(), frame.size());
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				written = chunk + 1;
+			}
+			changed.notify_all();
+		}
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+		out.flush();
+	}
+
+private:
+	ConcurrentCharacterFactory& factory;
+	size_t threadCount;
+	size_t chunkSize;
+};
+
+/*
+ * renderFile
+ * renders a file of any size straight from its DocumentStream windows
+ */
+bool renderFile(const std::string& path, CharacterFactory& factory, AnsiRenderer& renderer)
+{
+	DocumentStream stream(path);
+	if (!stream.isOpen()) {
+		std::cout << path << " : cannot open file" << std::endl;
+		return false;
+	}
+	size_t pointSize = 10;	// extrinsic state
+	stream.forEachChunk([&](const char* data, size_t size) {
+		for (size_t i = 0; i < size; i++)
+		{
+			factory.getFlyweight(data[i])->display(++pointSize, renderer);
+		}
+	});
+	renderer.flush();
+	return true;
+}
+
+/*
+ * renderFileParallel
+ * same as renderFile, every window of the file going through the ParallelRenderer pipeline
+ */
+bool renderFileParallel(const std::string& path, size_t threadCount, std::ostream& out)
+{
+	DocumentStream stream(path);
+	if (!stream.isOpen()) {
+		std::cout << path << " : cannot open file" << std::endl;
+		return false;
+	}
+	ConcurrentCharacterFactory factory;
+	ParallelRenderer pipeline(factory, threadCount);
+	size_t pointSize = 11;	// extrinsic state
+	stream.forEachChunk([&](const char* data, size_t size) {
+		pipeline.render(data, size, out, pointSize);
+		pointSize += size;
+	});
+	return true;
+}
+
+/*
+ * makeBenchmarkDocument
+ * fills a document with random lowercase letters and random color
+ * indices, always from the same seed so runs can be compared
+ */
+void makeBenchmarkDocument(std::string& document, std::vector<unsigned char>& colors)
+{
+	RandomGenerator::setSeed(2019);
+	RandomGenerator::fill(&document[0], &document[0] + document.size(), 'a', 'z');
+	RandomGenerator::fill(colors.data(), colors.data() + colors.size(), 0, colorCount - 1);
+}
+
+/*
+ * timeLookups
+ * resolves every glyph of the document through the factory and
+ * returns the elapsed time in microseconds
+ */
+template <typename Factory>
+long long timeLookups(Factory& factory, const std::string& document, const std::vector<unsigned char>& colors, uintptr_t& checksum)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < document.size(); i++)
+	{
+		checksum += reinterpret_cast<uintptr_t>(factory.getFlyweight(document[i], colors[i]).get());
+	}
+	auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
+}
+
+/*
+ * benchmarkLookup
+ * compares the std::map pool against the direct-indexed table
+ * on a 100M character document (colors are drawn up front so only
+ * the lookup itself is measured)
+ */
+void benchmarkLookup()
+{
+	constexpr size_t documentSize = 100000000;
+	std::string document(documentSize, ' ');
+	std::vector<unsigned char> colors(documentSize);
+	makeBenchmarkDocument(document, colors);
+
+	uintptr_t mapChecksum = 0;
+	uintptr_t tableChecksum = 0;
+	MapCharacterFactory mapFactory;
+	CharacterFactory tableFactory;
+	long long mapTime = timeLookups(mapFactory, document, colors, mapChecksum);
+	long long tableTime = timeLookups(tableFactory, document, colors, tableChecksum);
+
+	std::cout << std::endl << "getFlyweight over " << documentSize << " characters" << std::endl;
+	std::cout << "std::map pool    : " << mapTime << " microseconds ==> "
+		<< mapTime * 1000.0 / documentSize << " ns per character (checksum " << mapChecksum % 1000 << ")" << std::endl;
+	std::cout << "direct-indexed   : " << tableTime << " microseconds ==> "
+		<< tableTime * 1000.0 / documentSize << " ns per character (checksum " << tableChecksum % 1000 << ")" << std::endl;
+	std::cout << "speedup          : " << static_cast<double>(mapTime) / (tableTime ? tableTime : 1) << "x" << std::endl;
+}
+
+/*
+ * benchmarkHandle
+ * resolves and displays a 100M character document three ways, into a
+ * discarding stream; the differences between rows are the cost of the
+ * shared_ptr reference count and of the virtual display call per glyph
+ */
+void benchmarkHandle()
+{
+	constexpr size_t documentSize = 100000000;
+	std::string document(documentSize, ' ');
+	std::vector<unsigned char> colors(documentSize);
+	makeBenchmarkDocument(document, colors);
+	std::ostream discard(nullptr);
+	AnsiRenderer renderer(discard);
+	CharacterFactory characterFactory;
+	GlyphFactory glyphFactory;
+
+	auto time = [&](auto&& displayGlyph) {	// best of 3 runs
+		double best = 0;
+		for (int run = 0; run < 3; run++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < documentSize; i++)
+			{
+				displayGlyph(document[i], colors[i], 11 + i);
+			}
+			auto stop = std::chrono::steady_clock::now();
+			const double ns = std::chrono::duration<double, std::nano>(stop - start).count() / documentSize;
+			best = (run == 0) ? ns : std::min(best, ns);
+		}
+		return best;
+	};
+	const double byValue = time([&](char symbol, int indexColor, size_t pointSize) {
+		characterFactory.getFlyweight(symbol, indexColor)->display(pointSize, renderer);
+	});
+	const double byReference = time([&](char symbol, int indexColor, size_t pointSize) {
+		characterFactory.getFlyweightAt(slotIndex(symbol, indexColor))->display(pointSize, renderer);
+	});
+	const double byHandle = time([&](char symbol, int indexColor, size_t pointSize) {
+		glyphFactory.getFlyweight(symbol, indexColor).display(pointSize, renderer);
+	});
+
+	std::cout << std::endl << "getFlyweight + display over " << documentSize << " characters" << std::endl;
+	std::cout << std::setw(36) << "flyweight" << std::setw(16) << "atomics/glyph" << std::setw(18) << "indirect calls"
+		<< std::setw(12) << "ns/glyph" << std::endl << std::fixed << std::setprecision(2);
+	std::cout << std::setw(36) << "shared_ptr by value, virtual" << std::setw(16) << 2 << std::setw(18) << 1 << std::setw(12) << byValue << std::endl;
+	std::cout << std::setw(36) << "shared_ptr by reference, virtual" << std::setw(16) << 0 << std::setw(18) << 1 << std::setw(12) << byReference << std::endl;
+	std::cout << std::setw(36) << "Glyph handle, static" << std::setw(16) << 0 << std::setw(18) << 0 << std::setw(12) << byHandle << std::endl;
+	std::cout << "reference count : " << byValue - byReference << " ns per glyph, virtual call : "
+		<< byReference - byHandle << " ns per glyph" << std::endl;
+}
+
+/*
+ * benchmarkConcurrent
+ * resolves a 64M character document against one shared
+ * ConcurrentCharacterFactory with 1 to 64 threads, each thread
+ * taking an equal slice of the document
+ */
+void benchmarkConcurrent()
+{
+	constexpr size_t documentSize = 64000000;
+	std::string document(documentSize, ' ');
+	std::vector<unsigned char> colors(documentSize);
+	makeBenchmarkDocument(document, colors);
+
+	std::cout << std::endl << "shared getFlyweight over " << documentSize << " characters ("
+		<< std::thread::hardware_concurrency() << " hardware threads)" << std::endl;
+	long long singleThreadTime = 0;
+	for (size_t threadCount = 1; threadCount <= 64; threadCount *= 2)
+	{
+		ConcurrentCharacterFactory factory;	// fresh pool: threads also race to intern the glyphs
+		std::vector<uintptr_t> checksums(threadCount, 0);
+		std::vector<std::thread> workers;
+
+		auto start = std::chrono::steady_clock::now();
+		for (size_t t = 0; t < threadCount; t++)
+		{
+			workers.emplace_back([&, t]() {
+				const size_t first = documentSize * t / threadCount;
+				const size_t last = documentSize * (t + 1) / threadCount;
+				uintptr_t checksum = 0;
+				for (size_t i = first; i < last; i++)
+				{
+					checksum += reinterpret_cast<uintptr_t>(factory.getFlyweight(document[i], colors[i]).get());
+				}
+				checksums[t] = checksum;
+			});
+		}
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+		auto stop = std::chrono::steady_clock::now();
+		long long time = std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
+		if (threadCount == 1) {
+			singleThreadTime = time;
+		}
+
+		uintptr_t checksum = 0;
+		for (uintptr_t value : checksums)
+		{
+			checksum += value;
+		}
+		std::cout << "\n" << threadCount << " threads : " << time << " microseconds ==> "
+			<< documentSize / (time ? time : 1) << " M characters per second, speedup "
+			<< static_cast<double>(singleThreadTime) / (time ? time : 1) << "x (checksum " << checksum % 1000 << ")" << std::endl;
+	}
+}
+
+/*
+ * benchmarkPipeline
+ * renders a 256M character document through ParallelRenderer with
+ * 1 to 64 threads into a discarding stream
+ */
+void benchmarkPipeline()
+{
+	constexpr size_t documentSize = 256000000;
+	std::string document(documentSize, ' ');
+	RandomGenerator::setSeed(2019);
+	RandomGenerator::fill(&document[0], &document[0] + document.size(), 'a', 'z');
+	ConcurrentCharacterFactory factory;
+	std::ostream discard(nullptr);
+
+	std::cout << std::endl << "pipeline over " << documentSize << " characters ("
+		<< std::thread::hardware_concurrency() << " hardware threads)" << std::endl;
+	long long singleThreadTime = 0;
+	for (size_t threadCount = 1; threadCount <= 64; threadCount *= 2)
+	{
+		ParallelRenderer pipeline(factory, threadCount);
+		auto start = std::chrono::steady_clock::now();
+		pipeline.render(document.data(), document.size(), discard);
+		auto stop = std::chrono::steady_clock::now();
+		long long time = std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
+		if (threadCount == 1) {
+			singleThreadTime = time;
+		}
+		std::cout << "\n" << threadCount << " threads : " << time << " microseconds ==> "
+			<< documentSize / (time ? time : 1) << " M characters per second, speedup "
+			<< static_cast<double>(singleThreadTime) / (time ? time : 1) << "x" << std::endl;
+	}
+}
+
+/*
+ * residentBytes
+ * resident set size of the process (0 where it is not available)
+ */
+size_t residentBytes()
+{
+#ifdef __linux__
+	std::ifstream statm("/proc/self/statm");
+	size_t pages = 0;
+	size_t resident = 0;
+	statm >> pages >> resident;
+	return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+	return 0;
+#endif
 }
 
+// hands freed heap pages back to the system so the next run starts from a clean baseline
+void releaseFreeMemory()
+{
+#ifdef __GLIBC__
+	malloc_trim(0);
+#endif
+}
+
+/*
+ * CountingResource
+ * memory resource counting what it passes on to the default one: the suite
+ * builds each document or glyph set from its own, so allocations are
+ * counted there only and the rest of the program is not instrumented
+ */
+class CountingResource : public std::pmr::memory_resource {
+public:
+	size_t allocations() const { return allocationCount; }
+	size_t bytes() const { return allocationBytes; }
+
 private:
-	std::map<std::pair<char, int>, std::shared_ptr<Character>> characters;
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		allocationCount++;
+		allocationBytes += bytes;
+		return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* memory, size_t bytes, size_t alignment) override
+	{
+		std::pmr::new_delete_resource()->deallocate(memory, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+	size_t allocationCount = 0;
+	size_t allocationBytes = 0;
+};
+
+struct SuiteResult {
+	double lookupNs;		// per getFlyweight (shared) or per glyph object creation (unshared)
+	double displayNs;
+	double allocationsPerGlyph;
+	double heapBytesPerGlyph;
+	double residentBytesPerGlyph;
 };
 
+/*
+ * runShared
+ * a Document (extrinsic state in columns) resolved block by block
+ * through CharacterFactory::getFlyweight, then displayed; the heap
+ * counted is the document's, the flyweights being interned beforehand
+ */
+SuiteResult runShared(size_t glyphs, CharacterFactory& factory, AnsiRenderer& renderer)
+{
+	releaseFreeMemory();
+	const size_t resident = residentBytes();
+	CountingResource heap;
 
+	Document document(&heap);
+	document.appendRandom(glyphs, 11);
+	const unsigned char* symbol = document.symbolData();
+	const unsigned char* color = document.colorData();
+	const uint32_t* pointSize = document.pointSizeData();
 
-int main()
+	constexpr size_t blockSize = 512;
+	std::array<const Character*, blockSize> characters;
+	std::chrono::steady_clock::duration lookupTime{ 0 };
+	std::chrono::steady_clock::duration displayTime{ 0 };
+	for (size_t block = 0; block < glyphs; block += blockSize)
+	{
+		const size_t count = std::min(blockSize, glyphs - block);
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < count; i++)
+		{
+			characters[i] = factory.getFlyweight(symbol[block + i], color[block + i]).get();
+		}
+		auto resolved = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < count; i++)
+		{
+			characters[i]->display(pointSize[block + i], renderer);
+		}
+		auto displayed = std::chrono::steady_clock::now();
+		lookupTime += resolved - start;
+		displayTime += displayed - resolved;
+	}
+
+	const double count = static_cast<double>(glyphs);
+	return SuiteResult{
+		std::chrono::duration<double, std::nano>(lookupTime).count() / count,
+		std::chrono::duration<double, std::nano>(displayTime).count() / count,
+		heap.allocations() / count,
+		heap.bytes() / count,
+		(static_cast<double>(residentBytes()) - resident) / count };
+}
+
+/*
+ * runUnshared
+ * one UnsharedCharacter object per glyph (Number style), then displayed;
+ * the heap counted is the objects and the array pointing to them
+ */
+SuiteResult runUnshared(size_t glyphs, AnsiRenderer& renderer)
 {
+	releaseFreeMemory();
+	const size_t resident = residentBytes();
+	CountingResource heap;
+	std::pmr::polymorphic_allocator<UnsharedCharacter> allocator(&heap);
 
-	std::string document;
-	constexpr const char alphabets[26] = { 'a','b','c','d','e','f','g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v','w','x','y','z' };
-	for (size_t i = 0; i < 1000; i++)
+	std::pmr::vector<UnsharedCharacter*> characters(&heap);
+	characters.reserve(glyphs);
+	constexpr size_t blockSize = 512;
+	std::array<unsigned char, blockSize> symbols;
+	std::array<unsigned char, blockSize> colors;
+	std::chrono::steady_clock::duration lookupTime{ 0 };
+	for (size_t block = 0; block < glyphs; block += blockSize)
 	{
-		document += alphabets[generateRandomNumber(0, 25)];
+		const size_t count = std::min(blockSize, glyphs - block);
+		RandomGenerator::fill(symbols.data(), symbols.data() + count, 'a', 'z');
+		RandomGenerator::fill(colors.data(), colors.data() + count, 0, colorCount - 1);
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < count; i++)
+		{
+			UnsharedCharacter* character = allocator.allocate(1);
+			allocator.construct(character, palette[colors[i]], symbols[i], 11 + block + i);
+			characters.push_back(character);
+		}
+		lookupTime += std::chrono::steady_clock::now() - start;
 	}
-	std::cout << "random message created" << std::endl;
+	const size_t residentAfter = residentBytes();
 
-	std::unique_ptr<CharacterFactory> factory = std::make_unique<CharacterFactory>();
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < glyphs; i++)
+	{
+		characters[i]->display(11 + i, renderer);
+	}
+	std::chrono::steady_clock::duration displayTime = std::chrono::steady_clock::now() - start;
+
+	const double count = static_cast<double>(glyphs);
+	SuiteResult result{
+		std::chrono::duration<double, std::nano>(lookupTime).count() / count,
+		std::chrono::duration<double, std::nano>(displayTime).count() / count,
+		heap.allocations() / count,
+		heap.bytes() / count,
+		(static_cast<double>(residentAfter) - resident) / count };
+	for (UnsharedCharacter* character : characters)
+	{
+		allocator.destroy(character);
+		allocator.deallocate(character, 1);
+	}
+	return result;
+}
+
+void printSuiteResult(size_t glyphs, const char* mode, const SuiteResult& result)
+{
+	std::cout << std::setw(11) << glyphs << std::setw(10) << mode << std::fixed << std::setprecision(2)
+		<< std::setw(14) << result.lookupNs << std::setw(12) << result.displayNs
+		<< std::setw(14) << result.allocationsPerGlyph << std::setw(14) << result.heapBytesPerGlyph
+		<< std::setw(14) << result.residentBytesPerGlyph << std::endl;
+}
+
+/*
+ * benchmarkSuite
+ * sweeps documents from 1K to maxGlyphs glyphs (x10 each step), shared
+ * flyweights against one unshared object per glyph; rendering goes to a
+ * discarding stream so only the flyweight work is measured
+ * the unshared baseline costs ~40 bytes per glyph and is only run up to
+ * maxUnsharedGlyphs
+ */
+void benchmarkSuite(size_t maxGlyphs, size_t maxUnsharedGlyphs)
+{
+	RandomGenerator::setSeed(2019);
+	std::ostream discard(nullptr);
+	AnsiRenderer renderer(discard);
+	CharacterFactory factory;
+	for (char symbol = 'a'; symbol <= 'z'; symbol++)	// intern every glyph before the table is printed
+	{
+		for (size_t indexColor = 0; indexColor < colorCount; indexColor++)
+		{
+			factory.getFlyweight(symbol, indexColor);
+		}
+	}
 
-	// extrinsic state
-	int pointSize = 10;
+	std::cout << std::endl << std::setw(11) << "glyphs" << std::setw(10) << "mode"
+		<< std::setw(14) << "ns/lookup" << std::setw(12) << "ns/display"
+		<< std::setw(14) << "allocs/glyph" << std::setw(14) << "heap B/glyph"
+		<< std::setw(14) << "RSS B/glyph" << std::endl;
+	for (size_t glyphs = 1000; glyphs <= maxGlyphs; glyphs *= 10)
+	{
+		printSuiteResult(glyphs, "shared", runShared(glyphs, factory, renderer));
+		if (glyphs <= maxUnsharedGlyphs) {
+			printSuiteResult(glyphs, "unshared", runUnshared(glyphs, renderer));
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && std::string(argv[1]) == "--bench-lookup")
+	{
+		benchmarkLookup();
+		return 0;
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench-handle")
+	{
+		benchmarkHandle();
+		return 0;
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench-concurrent")
+	{
+		benchmarkConcurrent();
+		return 0;
+	}
+	if (argc > 2 && std::string(argv[1]) == "--file")
+	{
+		// --file path [threads]
+		const size_t threadCount = argc > 3 ? std::stoul(argv[3]) : 1;
+		if (threadCount > 1) {
+			return renderFileParallel(argv[2], threadCount, std::cout) ? 0 : 1;
+		}
+		CharacterFactory factory;
+		AnsiRenderer renderer(std::cout);
+		return renderFile(argv[2], factory, renderer) ? 0 : 1;
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench-pipeline")
+	{
+		benchmarkPipeline();
+		return 0;
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench-suite")
+	{
+		// --bench-suite [maxGlyphs] [maxUnsharedGlyphs]
+		benchmarkSuite(argc > 2 ? std::stoull(argv[2]) : 100000000, argc > 3 ? std::stoull(argv[3]) : 10000000);
+		return 0;
+	}
+#ifdef _WIN32
+	// let the Windows console interpret the ANSI sequences of AnsiRenderer
+	HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+	DWORD consoleMode = 0;
+	if (GetConsoleMode(hConsole, &consoleMode)) {
+		SetConsoleMode(hConsole, consoleMode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+	}
+#endif
 
-	for (const char& c : document)
+	std::string message;
+	constexpr const char alphabets[26] = { 'a','b','c','d','e','f','g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v','w','x','y','z' };
+	std::vector<int> letters(1000);
+	RandomGenerator::fill(letters.data(), letters.data() + letters.size(), 0, 25);
+	for (const int& letter : letters)
 	{
-		pointSize++;
-		std::shared_ptr<Character> character = factory->getFlyweight(c);
-		character->display(pointSize);
+		message += alphabets[letter];
 	}
-	SetConsoleTextAttribute(hConsole, colorDEFAULT);
+	std::cout << "random message created" << std::endl;
+
+	std::unique_ptr<CharacterFactory> factory = std::make_unique<CharacterFactory>();
+	AnsiRenderer renderer(std::cout);
+
+	// extrinsic state (color and point size of every glyph) lives in the document
+	Document document;
+	document.appendText(message, 11);
+	document.render(*factory, renderer, 0, document.size());
+	renderer.flush();
+	std::cout << std::endl;
 	// if we run example for document containe random 1000 ObjectCharWithColor and print out(oups need to remove std::endl for flush sorry) 
 	// with random color(Blue/Green/Red):
 	// code without Flyweight design : 1569546 microseconds ==> 1,569546 seconds
@@ -219,6 +1391,8 @@ int main()
 	// document containe random 100000 ObjectCharWithColor and print out with random color(Blue/Green/Red):
 	// code without Flyweight design : 88187505 microseconds ==> 88,187505 seconds
 	// code with Flyweight design 	 : 63950289 microseconds ==> 63,950289 seconds
+#ifdef _WIN32
 	system("pause");
+#endif
 	return 0;
 }
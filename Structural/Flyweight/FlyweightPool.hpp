@@ -0,0 +1,189 @@
+/*
+* C++ Design Patterns: Flyweight
+* Author: walid Abbassi [https://github.com/walidAbbassi]
+* 2019
+*
+* Source code is licensed under MIT License
+* (for more details see LICENSE)
+*
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+/*
+ * DefaultSizeOf
+ * bytes accounted for one interned value, measured on the concrete type the
+ * factory created (specialize or pass your own functor for values owning heap memory)
+ */
+template <typename Value>
+struct DefaultSizeOf {
+	template <typename Concrete>
+	size_t operator()(const Concrete&) const { return sizeof(Concrete); }
+};
+
+/*
+ * FlyweightPool ==> FlyweightFactory
+ * reusable interning pool: returns the shared value of a key and creates it
+ * on first request only
+ *  - Mode::Strong : the pool keeps every value alive (classic flyweight factory)
+ *  - Mode::Weak   : the pool only keeps weak references, a value is released
+ *                   as soon as the last client drops it
+ *  - Mode::Lru    : the pool keeps at most `capacity` values alive and evicts
+ *                   the least recently used one
+ * the counters are atomics so they can be watched while the pool is in use
+ */
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename SizeOf = DefaultSizeOf<Value>>
+class FlyweightPool {
+public:
+	enum class Mode { Strong, Weak, Lru };
+
+	struct Stats {
+		size_t entries;		// values created by the pool and still alive
+		size_t bytesHeld;	// memory of those values
+		size_t bytesSaved;	// memory an unshared copy per request would have added
+		size_t hits;
+		size_t misses;
+		size_t evictions;
+	};
+
+	explicit FlyweightPool(Mode mode = Mode::Strong, size_t capacity = 0, const Hash& hash = Hash(), const SizeOf& sizeOf = SizeOf()) :
+		mode(mode), capacity(capacity), sizeOf(sizeOf), entries(0, hash), counters(std::make_shared<Counters>()) {}
+
+	FlyweightPool(const FlyweightPool&) = delete;
+	FlyweightPool& operator=(const FlyweightPool&) = delete;
+
+	// create(key) is only called on a miss and returns a std::unique_ptr to the new value
+	// (or to a class derived from Value, which is then the type accounted for)
+	template <typename Factory>
+	std::shared_ptr<Value> get(const Key& key, Factory&& create)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto found = entries.find(key);
+		if (found != entries.end()) {
+			std::shared_ptr<Value> value = (mode == Mode::Weak) ? found->second.weak.lock() : found->second.strong;
+			if (value) {
+				if (mode == Mode::Lru) {
+					order.splice(order.begin(), order, found->second.position);
+				}
+				counters->hits++;
+				counters->bytesSaved += found->second.bytes;
+				return value;
+			}
+			entries.erase(found);	// weak reference expired
+		}
+
+		counters->misses++;
+		size_t bytes = 0;
+		std::shared_ptr<Value> value = adopt(create(key), bytes);
+		Entry& entry = entries[key];
+		entry.bytes = bytes;
+		if (mode == Mode::Weak) {
+			entry.weak = value;
+			if (entries.size() >= nextPurge) {
+				purgeExpired();
+			}
+		}
+		else {
+			entry.strong = value;
+		}
+		if (mode == Mode::Lru) {
+			order.push_front(key);
+			entry.position = order.begin();
+			if (capacity != 0 && order.size() > capacity) {
+				entries.erase(order.back());
+				order.pop_back();
+				counters->evictions++;
+			}
+		}
+		return value;
+	}
+
+	std::shared_ptr<Value> get(const Key& key)
+	{
+		return get(key, [](const Key& k) { return std::make_unique<Value>(k); });
+	}
+
+	// drops the weak references whose value has already been released
+	void purge()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		purgeExpired();
+	}
+
+	size_t size() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return entries.size();
+	}
+
+	Stats stats() const
+	{
+		return Stats{ counters->entries, counters->bytesHeld, counters->bytesSaved,
+			counters->hits, counters->misses, counters->evictions };
+	}
+
+private:
+	struct Counters {
+		std::atomic<size_t> entries{ 0 };
+		std::atomic<size_t> bytesHeld{ 0 };
+		std::atomic<size_t> bytesSaved{ 0 };
+		std::atomic<size_t> hits{ 0 };
+		std::atomic<size_t> misses{ 0 };
+		std::atomic<size_t> evictions{ 0 };
+	};
+
+	struct Entry {
+		std::shared_ptr<Value> strong;
+		std::weak_ptr<Value> weak;
+		typename std::list<Key>::iterator position;
+		size_t bytes = 0;
+	};
+
+	// the deleter shares the counters, so a value may outlive the pool;
+	// it also deletes through the created type
+	template <typename Created>
+	std::shared_ptr<Value> adopt(std::unique_ptr<Created> created, size_t& bytes)
+	{
+		bytes = sizeOf(*created);
+		counters->entries++;
+		counters->bytesHeld += bytes;
+		std::shared_ptr<Counters> shared = counters;
+		return std::shared_ptr<Value>(created.release(), [shared, bytes](Created* value) {
+			shared->entries--;
+			shared->bytesHeld -= bytes;
+			delete value;
+		});
+	}
+
+	void purgeExpired()
+	{
+		for (auto entry = entries.begin(); entry != entries.end(); )
+		{
+			if (mode == Mode::Weak && entry->second.weak.expired()) {
+				entry = entries.erase(entry);
+			}
+			else {
+				++entry;
+			}
+		}
+		nextPurge = std::max<size_t>(64, 2 * entries.size());
+	}
+
+	Mode mode;
+	size_t capacity;
+	SizeOf sizeOf;
+	std::unordered_map<Key, Entry, Hash> entries;
+	std::list<Key> order;			// most recently used first (Mode::Lru)
+	size_t nextPurge = 64;			// entry count that triggers the next sweep (Mode::Weak)
+	std::shared_ptr<Counters> counters;
+	mutable std::mutex mutex;
+};
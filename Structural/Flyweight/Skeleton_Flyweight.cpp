@@ -8,8 +8,8 @@
 *
 */
 
+#include "FlyweightPool.hpp"
 #include <iostream>
-#include <map>
 #include <memory>
 #include <string>
 
@@ -65,23 +65,20 @@ private:
 /*
  * CharacterFactory ==> FlyweightFactory
  * creates and manages flyweight objects and ensures
- * that flyweights are shared properly
+ * that flyweights are shared properly (the interning itself
+ * is done by the generic FlyweightPool)
  */
 class FlyweightFactory {
 public:
 	std::shared_ptr<FlyWeight>getFlyweight(int key) 
 	{
-		if (flies.find(key) != flies.end()) 
-		{
-			return flies[key];
-		}
-		std::shared_ptr<FlyWeight>fly = std::make_shared<ConcreteFlyweight>(key);
-		flies.insert(std::pair<int, std::shared_ptr<FlyWeight>>(key, fly));
-		return fly;
+		return flies.get(key, [](const int& state) { return std::make_unique<ConcreteFlyweight>(state); });
 	}
 
+	FlyweightPool<int, FlyWeight>::Stats stats() const { return flies.stats(); }
+
 private:
-	std::map<int, std::shared_ptr<FlyWeight>> flies;
+	FlyweightPool<int, FlyWeight> flies;
 };
 
 
@@ -92,8 +89,11 @@ int main()
 	std::unique_ptr<FlyweightFactory> factory = std::make_unique<FlyweightFactory>();
 	for (size_t i = 0; i < 100; i++)
 	{
-		factory->getFlyweight(i)->operation();
+		factory->getFlyweight(i % 10)->operation();
 	}
+	FlyweightPool<int, FlyWeight>::Stats stats = factory->stats();
+	std::cout << stats.entries << " flyweights, " << stats.bytesHeld << " bytes held, "
+		<< stats.bytesSaved << " bytes saved" << std::endl;
 	system("pause");
 	return 0;
 }
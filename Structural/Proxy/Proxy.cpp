@@ -8,11 +8,50 @@
 *
 */
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PROXY_POSIX_SOCKETS
+#endif
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#include <emmintrin.h>
+#define PROXY_SSE2_SCAN
+#endif
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iomanip>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
 #include <regex>
 #include <set>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 /*
  * Internet  ==>  Subject
@@ -24,34 +63,1944 @@ public:
 	virtual ~Internet() { /* ... */ }
 
 	virtual void connectTo (const std::string &serverHost) const = 0;
+
+	// batch entry point over serverHosts[0..count): one decision per URL,
+	// true when the connection was made
+	virtual std::vector<bool> connectToBatch(const std::string* serverHosts, size_t count) const
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			connectTo(serverHosts[i]);
+		}
+		return std::vector<bool>(count, true);
+	}
+
+protected:
+	// hands every run of admitted URLs to next as one batch, and clears
+	// admitted[i] where next did not make the connection
+	static void forwardAdmitted(const Internet& next, const std::string* serverHosts, std::vector<bool>& admitted)
+	{
+		for (size_t first = 0; first < admitted.size(); )
+		{
+			if (!admitted[first]) {
+				first++;
+				continue;
+			}
+			size_t last = first;
+			while (last < admitted.size() && admitted[last])
+			{
+				last++;
+			}
+			const std::vector<bool> connected = next.connectToBatch(serverHosts + first, last - first);
+			for (size_t i = first; i < last; i++)
+			{
+				admitted[i] = connected[i - first];
+			}
+			first = last;
+		}
+	}
+};
+
+/*
+ * RealInternet  ==>  Real Subject
+ * defines the real object that the proxy represents
+ */
+class RealInternet : public Internet {
+public:
+	RealInternet() = default;
+	void connectTo(const std::string &serverHost) const override 
+	{
+		std::cout << "Connecting to " << serverHost << std::endl;
+	}
+};
+
+/*
+ * isWordChar
+ * the \w class of the ECMAScript regex grammar: [A-Za-z0-9_]
+ */
+constexpr bool isWordChar(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+/*
+ * scanHostRun
+ * end of the run of [\w.-] that starts at position; lastDot receives the
+ * position of its last '.' (left untouched when the run has none)
+ * with SSE2, 16 characters are classified per step
+ */
+size_t scanHostRun(std::string_view url, size_t position, size_t& lastDot)
+{
+#ifdef PROXY_SSE2_SCAN
+	while (position + 16 <= url.size())
+	{
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(url.data() + position));
+		// bytes >= 0x80 compare as negative, so they fall outside every range
+		const __m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+		const __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+		const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(chunk, _mm_set1_epi8('9' + 1)));
+		const __m128i dot = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('.'));
+		const __m128i other = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('_')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('-')));
+		const unsigned hostMask = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letter, digit), _mm_or_si128(dot, other))));
+		unsigned dotMask = static_cast<unsigned>(_mm_movemask_epi8(dot));
+		const unsigned stopMask = ~hostMask & 0xFFFFu;
+		if (stopMask != 0) {
+			const unsigned length = static_cast<unsigned>(__builtin_ctz(stopMask));
+			dotMask &= (1u << length) - 1;
+			if (dotMask != 0) {
+				lastDot = position + 31 - __builtin_clz(dotMask);
+			}
+			return position + length;
+		}
+		if (dotMask != 0) {
+			lastDot = position + 31 - __builtin_clz(dotMask);
+		}
+		position += 16;
+	}
+#endif
+	while (position < url.size() && (isWordChar(url[position]) || url[position] == '.' || url[position] == '-'))
+	{
+		if (url[position] == '.') {
+			lastDot = position;
+		}
+		position++;
+	}
+	return position;
+}
+
+/*
+ * extractHost
+ * hand-written, allocation-free equivalent of group 3 of ProxyInternet's urlRegex:
+ * the first run of [\w.-] holding a '.', cut after the word characters that
+ * follow its last '.' (the optional scheme needs no special case, ':' and '/'
+ * end a run); returns an empty view when the regex would not match
+ */
+std::string_view extractHost(std::string_view url)
+{
+	size_t position = 0;
+	while (position < url.size())
+	{
+		const size_t first = position;
+		size_t lastDot = std::string_view::npos;
+		position = scanHostRun(url, position, lastDot);
+		if (lastDot != std::string_view::npos) {
+			size_t last = lastDot + 1;
+			while (last < position && isWordChar(url[last]))
+			{
+				last++;
+			}
+			return url.substr(first, last - first);
+		}
+		position++;	// skip the delimiter
+	}
+	return std::string_view();
+}
+
+/*
+ * hashHost
+ * 64-bit FNV-1a of a host name
+ */
+uint64_t hashHost(std::string_view host)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : host)
+	{
+		hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+	}
+	return hash;
+}
+
+/*
+ * Blocklist
+ * immutable set of banned hosts sized for millions of entries:
+ *  - the hosts are sorted, deduplicated and packed back to back in one blob
+ *    (no per-host heap string, no tree node)
+ *  - an open-addressing table of 64-bit entries (32-bit hash tag, 32-bit host
+ *    index) answers a lookup in about one cache miss
+ *  - an optional blocked Bloom filter (~10 bits per host, all probe bits in
+ *    one 64-bit word) rejects most allowed hosts before the table is touched
+ * everything lives in one contiguous image, which is also the on-disk index
+ * format: save() writes it, open() memory-maps it and queries it in place,
+ * so startup is constant time and processes share the same physical pages
+ *   header | table (u64) | bloom (u64) | offsets (u32, hosts + 1) | blob | rules
+ * (native byte order); rules is the text of the wildcard and suffix rules
+ * that come with the hosts, one per line, for the DomainTrie of a BanList
+ */
+class Blocklist {
+public:
+	explicit Blocklist(std::vector<std::string_view> hosts, bool bloomFilter = true,
+		const std::vector<std::string_view>& domainRules = {})
+	{
+		std::sort(hosts.begin(), hosts.end());
+		hosts.erase(std::unique(hosts.begin(), hosts.end()), hosts.end());
+
+		Header header{};
+		std::copy(std::begin(magic), std::end(magic), header.magic);
+		header.hostCount = hosts.size();
+		for (std::string_view host : hosts)
+		{
+			header.blobBytes += host.size();
+		}
+		for (std::string_view rule : domainRules)
+		{
+			header.ruleBytes += rule.size() + 1;
+		}
+		if (header.blobBytes > UINT32_MAX || hosts.size() >= UINT32_MAX) {
+			std::cout << "blocklist too large" << std::endl;
+			throw("blocklist too large");
+		}
+		header.tableSize = powerOfTwoAtLeast(hosts.size() + hosts.size() / 2 + 1);
+		header.bloomSize = bloomFilter ? powerOfTwoAtLeast(hosts.size() * 10 / 64 + 1) : 0;
+
+		image.assign((imageBytes(header) + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+		std::memcpy(image.data(), &header, sizeof(header));
+		attach(reinterpret_cast<const char*>(image.data()));
+
+		uint64_t* writableTable = const_cast<uint64_t*>(table);
+		uint64_t* writableBloom = const_cast<uint64_t*>(bloom);
+		uint32_t* writableOffsets = const_cast<uint32_t*>(offsets);
+		char* writableBlob = const_cast<char*>(blob);
+		uint32_t offset = 0;
+		for (size_t index = 0; index < hosts.size(); index++)
+		{
+			writableOffsets[index] = offset;
+			std::memcpy(writableBlob + offset, hosts[index].data(), hosts[index].size());
+			offset += static_cast<uint32_t>(hosts[index].size());
+
+			const uint64_t hash = hashHost(hosts[index]);
+			size_t slot = hash & tableMask;
+			while (writableTable[slot] != 0)
+			{
+				slot = (slot + 1) & tableMask;
+			}
+			writableTable[slot] = (hash & 0xFFFFFFFF00000000ull) | (index + 1);
+			if (bloomSize != 0) {
+				writableBloom[bloomWord(hash)] |= bloomBits(hash);
+			}
+		}
+		writableOffsets[hosts.size()] = offset;
+
+		char* writableRules = writableBlob + offset;
+		for (std::string_view rule : domainRules)
+		{
+			std::memcpy(writableRules, rule.data(), rule.size());
+			writableRules[rule.size()] = '\n';
+			writableRules += rule.size() + 1;
+		}
+	}
+
+	~Blocklist()
+	{
+#if defined(__unix__) || defined(__APPLE__)
+		if (mapping) {
+			::munmap(mapping, mappingBytes);
+		}
+#endif
+	}
+
+	Blocklist(const Blocklist&) = delete;
+	Blocklist& operator=(const Blocklist&) = delete;
+
+	// maps a file written by save(); nullptr if it cannot be opened or is not a blocklist index
+	static std::shared_ptr<const Blocklist> open(const std::string& path)
+	{
+		std::shared_ptr<Blocklist> blocklist(new Blocklist());
+#if defined(__unix__) || defined(__APPLE__)
+		const int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0) {
+			return nullptr;
+		}
+		struct stat status;
+		if (::fstat(file, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(Header)) {
+			::close(file);
+			return nullptr;
+		}
+		blocklist->mappingBytes = static_cast<size_t>(status.st_size);
+		void* mapping = ::mmap(nullptr, blocklist->mappingBytes, PROT_READ, MAP_SHARED, file, 0);
+		::close(file);
+		if (mapping == MAP_FAILED) {
+			return nullptr;
+		}
+		blocklist->mapping = mapping;
+		const char* data = static_cast<const char*>(mapping);
+		const size_t size = blocklist->mappingBytes;
+#else
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file || static_cast<size_t>(file.tellg()) < sizeof(Header)) {
+			return nullptr;
+		}
+		const size_t size = static_cast<size_t>(file.tellg());
+		blocklist->image.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(blocklist->image.data()), size);
+		const char* data = reinterpret_cast<const char*>(blocklist->image.data());
+#endif
+		Header header;
+		std::memcpy(&header, data, sizeof(header));
+		if (!std::equal(std::begin(magic), std::end(magic), header.magic) || !validHeader(header, size)) {
+			return nullptr;
+		}
+		blocklist->attach(data);
+		if (blocklist->offsets[header.hostCount] != header.blobBytes) {
+			return nullptr;		// truncated or damaged host offsets
+		}
+		return blocklist;
+	}
+
+	// writes a temporary file next to path and renames it over path, so a
+	// process that has the previous index mapped keeps reading the old file
+	bool save(const std::string& path) const
+	{
+		Header header;
+		std::memcpy(&header, base, sizeof(header));
+		const size_t bytes = imageBytes(header);
+#if defined(__unix__) || defined(__APPLE__)
+		const std::string temporary = path + ".tmp" + std::to_string(::getpid());
+		const int file = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (file < 0) {
+			return false;
+		}
+		size_t written = 0;
+		while (written < bytes)
+		{
+			const ssize_t result = ::write(file, base + written, bytes - written);
+			if (result < 0 && errno == EINTR) {
+				continue;
+			}
+			if (result <= 0) {
+				break;
+			}
+			written += static_cast<size_t>(result);
+		}
+		bool saved = written == bytes && ::fsync(file) == 0;
+		saved = (::close(file) == 0) && saved;
+		if (!saved || ::rename(temporary.c_str(), path.c_str()) != 0) {
+			::unlink(temporary.c_str());
+			return false;
+		}
+		return true;
+#else
+		const std::string temporary = path + ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			file.write(base, bytes);
+			file.flush();
+			if (!file) {
+				std::remove(temporary.c_str());
+				return false;
+			}
+		}
+		std::remove(path.c_str());
+		return std::rename(temporary.c_str(), path.c_str()) == 0;
+#endif
+	}
+
+	bool contains(std::string_view host) const
+	{
+		const uint64_t hash = hashHost(host);
+		return bloomAccepts(hash) && probe(host, hash);
+	}
+
+	// batch lookup: a group of hosts is hashed and its Bloom words prefetched,
+	// then the table slots of the survivors, so the cache misses of the group
+	// overlap instead of being paid one after the other
+	void contains(const std::string_view* hosts, size_t count, bool* found) const
+	{
+		constexpr size_t groupSize = 16;
+		uint64_t hashes[groupSize];
+		bool candidate[groupSize];
+		for (size_t begin = 0; begin < count; begin += groupSize)
+		{
+			const size_t size = std::min(groupSize, count - begin);
+			for (size_t i = 0; i < size; i++)
+			{
+				hashes[i] = hashHost(hosts[begin + i]);
+				prefetch((bloomSize != 0) ? &bloom[bloomWord(hashes[i])] : &table[hashes[i] & tableMask]);
+			}
+			if (bloomSize != 0) {
+				for (size_t i = 0; i < size; i++)
+				{
+					candidate[i] = bloomAccepts(hashes[i]);
+					if (candidate[i]) {
+						prefetch(&table[hashes[i] & tableMask]);
+					}
+				}
+			}
+			for (size_t i = 0; i < size; i++)
+			{
+				found[begin + i] = (bloomSize == 0 || candidate[i]) && probe(hosts[begin + i], hashes[i]);
+			}
+		}
+	}
+
+	size_t size() const { return hostCount; }
+
+	// the wildcard and suffix rules stored with the hosts, one per line
+	std::string_view domainRules() const { return rules; }
+
+	size_t memoryBytes() const
+	{
+		Header header;
+		std::memcpy(&header, base, sizeof(header));
+		return imageBytes(header);
+	}
+
+	bool isMapped() const { return mapping != nullptr; }
+
+private:
+	struct Header {
+		char magic[8];
+		uint64_t hostCount;
+		uint64_t blobBytes;
+		uint64_t tableSize;		// entries, power of two
+		uint64_t bloomSize;		// words, power of two or 0
+		uint64_t ruleBytes;
+	};
+
+	static constexpr char magic[8] = { 'B', 'L', 'O', 'C', 'K', 'L', 'S', '2' };
+
+	Blocklist() = default;
+
+	static size_t imageBytes(const Header& header)
+	{
+		return sizeof(Header) + (header.tableSize + header.bloomSize) * sizeof(uint64_t)
+			+ (header.hostCount + 1) * sizeof(uint32_t) + header.blobBytes + header.ruleBytes;
+	}
+
+	// a header read from a file of `size` bytes: every array fits in the file
+	// (checked before imageBytes() can overflow), the table is a power of two
+	// with at least one empty slot so a probe always ends, and the Bloom
+	// filter is a power of two or absent
+	static bool validHeader(const Header& header, size_t size)
+	{
+		auto isPowerOfTwo = [](uint64_t value) { return value != 0 && (value & (value - 1)) == 0; };
+		if (header.tableSize > size / sizeof(uint64_t) || header.bloomSize > size / sizeof(uint64_t)
+			|| header.hostCount >= size / sizeof(uint32_t) || header.blobBytes > size || header.ruleBytes > size) {
+			return false;
+		}
+		return isPowerOfTwo(header.tableSize) && header.hostCount < header.tableSize
+			&& (header.bloomSize == 0 || isPowerOfTwo(header.bloomSize))
+			&& header.hostCount < UINT32_MAX && header.blobBytes <= UINT32_MAX
+			&& imageBytes(header) <= size;
+	}
+
+	// points the lookup arrays into an image starting with its header
+	void attach(const char* data)
+	{
+		Header header;
+		std::memcpy(&header, data, sizeof(header));
+		base = data;
+		hostCount = header.hostCount;
+		blobBytes = header.blobBytes;
+		tableMask = header.tableSize - 1;
+		bloomSize = header.bloomSize;
+		table = reinterpret_cast<const uint64_t*>(data + sizeof(Header));
+		bloom = table + header.tableSize;
+		offsets = reinterpret_cast<const uint32_t*>(bloom + header.bloomSize);
+		blob = reinterpret_cast<const char*>(offsets + header.hostCount + 1);
+		rules = std::string_view(blob + header.blobBytes, header.ruleBytes);
+	}
+
+	static size_t powerOfTwoAtLeast(size_t value)
+	{
+		size_t power = 8;
+		while (power < value)
+		{
+			power *= 2;
+		}
+		return power;
+	}
+
+	// the Bloom probes use a remix of the hash so they do not follow the table slot
+	size_t bloomWord(uint64_t hash) const
+	{
+		return ((hash * 0x9E3779B97F4A7C15ull) >> 32) & (bloomSize - 1);
+	}
+
+	static uint64_t bloomBits(uint64_t hash)
+	{
+		const uint64_t mixed = hash * 0x9E3779B97F4A7C15ull;
+		return (1ull << (mixed & 63)) | (1ull << ((mixed >> 6) & 63))
+			| (1ull << ((mixed >> 12) & 63)) | (1ull << ((mixed >> 18) & 63));
+	}
+
+	static void prefetch(const void* address)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		__builtin_prefetch(address);
+#else
+		(void)address;
+#endif
+	}
+
+	bool bloomAccepts(uint64_t hash) const
+	{
+		if (bloomSize == 0) {
+			return true;
+		}
+		const uint64_t bits = bloomBits(hash);
+		return (bloom[bloomWord(hash)] & bits) == bits;
+	}
+
+	bool probe(std::string_view host, uint64_t hash) const
+	{
+		for (size_t slot = hash & tableMask; ; slot = (slot + 1) & tableMask)
+		{
+			const uint64_t entry = table[slot];
+			if (entry == 0) {
+				return false;
+			}
+			const size_t index = static_cast<size_t>(entry & 0xFFFFFFFFull) - 1;
+			if ((entry >> 32) == (hash >> 32) && index < hostCount && hostAt(index) == host) {
+				return true;
+			}
+		}
+	}
+
+	// the bounds checks keep a damaged mapped index from reading past the blob
+	std::string_view hostAt(size_t index) const
+	{
+		const uint32_t first = offsets[index];
+		const uint32_t last = offsets[index + 1];
+		if (first > last || last > blobBytes) {
+			return std::string_view();
+		}
+		return std::string_view(blob + first, last - first);
+	}
+
+	std::vector<uint64_t> image;	// owned image (built in memory, or read where mmap is not available)
+	void* mapping = nullptr;		// mapped index file
+	size_t mappingBytes = 0;
+	const char* base = nullptr;
+	size_t hostCount = 0;
+	size_t blobBytes = 0;
+	size_t tableMask = 0;
+	size_t bloomSize = 0;
+	const uint64_t* table = nullptr;
+	const uint64_t* bloom = nullptr;
+	const uint32_t* offsets = nullptr;
+	const char* blob = nullptr;
+	std::string_view rules;
+};
+
+/*
+ * DomainTrie
+ * wildcard and suffix rules in a trie of reversed domain labels
+ * (com -> first -> www): a lookup walks the labels of the host from right
+ * to left, so its cost depends on the number of labels, not of rules, and
+ * exact and wildcard rules on the same path are resolved in that one pass
+ *  - addExact("first.com")    : bans first.com only
+ *  - addWildcard("first.com") : bans every subdomain of first.com (*.first.com)
+ * the edges live in one hash table keyed by (parent node, label)
+ */
+class DomainTrie {
+public:
+	DomainTrie() : flags(1, 0) {}
+
+	void addExact(std::string_view domain) { flags[insert(domain)] |= exactRule; }
+	void addWildcard(std::string_view domain) { flags[insert(domain)] |= wildcardRule; }
+
+	bool matches(std::string_view host) const
+	{
+		uint32_t node = 0;
+		size_t end = host.size();
+		while (true)
+		{
+			const size_t dot = host.rfind('.', end == 0 ? std::string_view::npos : end - 1);
+			const size_t first = (dot == std::string_view::npos) ? 0 : dot + 1;
+			auto child = edges.find(Edge{ node, host.substr(first, end - first) });
+			if (child == edges.end()) {
+				return false;
+			}
+			node = child->second;
+			if (first == 0) {
+				return (flags[node] & exactRule) != 0;
+			}
+			if (flags[node] & wildcardRule) {
+				return true;
+			}
+			end = dot;
+		}
+	}
+
+	size_t size() const { return flags.size() - 1; }	// nodes below the root
+
+private:
+	static constexpr uint8_t exactRule = 1;
+	static constexpr uint8_t wildcardRule = 2;
+
+	struct Edge {
+		uint32_t parent;
+		std::string_view label;
+		bool operator==(const Edge& other) const { return parent == other.parent && label == other.label; }
+	};
+
+	struct EdgeHash {
+		size_t operator()(const Edge& edge) const
+		{
+			return static_cast<size_t>(hashHost(edge.label) ^ (edge.parent * 0x9E3779B97F4A7C15ull));
+		}
+	};
+
+	uint32_t insert(std::string_view domain)
+	{
+		uint32_t node = 0;
+		size_t end = domain.size();
+		while (true)
+		{
+			const size_t dot = domain.rfind('.', end == 0 ? std::string_view::npos : end - 1);
+			const size_t first = (dot == std::string_view::npos) ? 0 : dot + 1;
+			const std::string_view label = domain.substr(first, end - first);
+			auto child = edges.find(Edge{ node, label });
+			if (child == edges.end()) {
+				labels.emplace_back(label);	// deque: the views on earlier labels stay valid
+				child = edges.emplace(Edge{ node, labels.back() }, static_cast<uint32_t>(flags.size())).first;
+				flags.push_back(0);
+			}
+			node = child->second;
+			if (first == 0) {
+				return node;
+			}
+			end = dot;
+		}
+	}
+
+	std::vector<uint8_t> flags;						// per node, root first
+	std::unordered_map<Edge, uint32_t, EdgeHash> edges;
+	std::deque<std::string> labels;
+};
+
+/*
+ * BanList
+ * the rules ProxyInternet enforces: exact hosts in a Blocklist (the bulk of
+ * a real list, possibly memory-mapped) and wildcard rules in a DomainTrie
+ */
+struct BanList {
+	std::shared_ptr<const Blocklist> hosts;
+	std::shared_ptr<const DomainTrie> domains;	// may be null
+
+	bool isBanned(std::string_view host) const
+	{
+		return hosts->contains(host) || (domains && domains->matches(host));
+	}
+
+	void isBanned(const std::string_view* hostViews, size_t count, bool* banned) const
+	{
+		hosts->contains(hostViews, count, banned);
+		if (domains) {
+			for (size_t i = 0; i < count; i++)
+			{
+				banned[i] = banned[i] || domains->matches(hostViews[i]);
+			}
+		}
+	}
+};
+
+/*
+ * host list rules: "*.first.com" bans the subdomains of first.com,
+ * ".first.com" bans first.com and its subdomains, any other line one host
+ */
+bool isDomainRule(std::string_view rule)
+{
+	return (rule.size() > 2 && rule.substr(0, 2) == "*.") || (rule.size() > 1 && rule.front() == '.');
+}
+
+// the DomainTrie of the wildcard and suffix rules (nullptr if there are none)
+std::shared_ptr<const DomainTrie> makeDomainTrie(const std::vector<std::string_view>& domainRules)
+{
+	if (domainRules.empty()) {
+		return nullptr;
+	}
+	std::shared_ptr<DomainTrie> domains = std::make_shared<DomainTrie>();
+	for (std::string_view rule : domainRules)
+	{
+		if (rule.front() == '*') {
+			domains->addWildcard(rule.substr(2));
+		}
+		else {
+			domains->addExact(rule.substr(1));
+			domains->addWildcard(rule.substr(1));
+		}
+	}
+	return domains;
+}
+
+/*
+ * makeBanList
+ * sorts host list rules into the Blocklist of exact hosts and the
+ * DomainTrie of wildcard and suffix rules
+ */
+std::shared_ptr<const BanList> makeBanList(const std::vector<std::string_view>& rules)
+{
+	std::vector<std::string_view> hosts;
+	std::vector<std::string_view> domainRules;
+	for (std::string_view rule : rules)
+	{
+		(isDomainRule(rule) ? domainRules : hosts).push_back(rule);
+	}
+	return std::make_shared<const BanList>(BanList{ std::make_shared<const Blocklist>(hosts), makeDomainTrie(domainRules) });
+}
+
+/*
+ * readHostList
+ * reads a blocklist file (one host per line, '#' starts a comment line):
+ * text receives the file and hosts the views on its lines
+ */
+bool readHostList(const std::string& path, std::string& text, std::vector<std::string_view>& hosts)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	std::ostringstream content;
+	content << file.rdbuf();
+	text = content.str();
+
+	std::string_view remaining(text);
+	while (!remaining.empty())
+	{
+		const size_t end = std::min(remaining.find('\n'), remaining.size());
+		std::string_view line = remaining.substr(0, end);
+		remaining.remove_prefix(std::min(end + 1, remaining.size()));
+		while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t'))
+		{
+			line.remove_suffix(1);
+		}
+		while (!line.empty() && (line.front() == ' ' || line.front() == '\t'))
+		{
+			line.remove_prefix(1);
+		}
+		if (!line.empty() && line.front() != '#') {
+			hosts.push_back(line);
+		}
+	}
+	return true;
+}
+
+/*
+ * loadBanList
+ * maps a prebuilt index (see --compile-blocklist), its wildcard and suffix
+ * rules rebuilt into a DomainTrie, or builds the rules from a host list;
+ * nullptr if the file cannot be read or is an index that does not open
+ */
+std::shared_ptr<const BanList> loadBanList(const std::string& path)
+{
+	if (std::shared_ptr<const Blocklist> index = Blocklist::open(path)) {
+		std::vector<std::string_view> domainRules;
+		std::string_view rules = index->domainRules();
+		while (!rules.empty())
+		{
+			const size_t end = rules.find('\n');
+			const std::string_view rule = rules.substr(0, end);
+			if (isDomainRule(rule)) {
+				domainRules.push_back(rule);
+			}
+			rules.remove_prefix(std::min(end, rules.size() - 1) + 1);
+		}
+		return std::make_shared<const BanList>(BanList{ index, makeDomainTrie(domainRules) });
+	}
+	std::string text;
+	std::vector<std::string_view> rules;
+	if (!readHostList(path, text, rules)) {
+		return nullptr;
+	}
+	if (text.compare(0, 7, "BLOCKLS") == 0) {
+		std::cout << path << " : damaged or outdated blocklist index, compile it again" << std::endl;
+		return nullptr;
+	}
+	return makeBanList(rules);
+}
+
+/*
+ * compileBlocklist
+ * offline tool: compiles a host list into an immutable index file
+ * (exact hosts in the table, wildcard and suffix rules as text after them)
+ */
+bool compileBlocklist(const std::string& hostListPath, const std::string& indexPath)
+{
+	std::string text;
+	std::vector<std::string_view> rules;
+	auto start = std::chrono::steady_clock::now();
+	if (!readHostList(hostListPath, text, rules)) {
+		std::cout << hostListPath << " : cannot open file" << std::endl;
+		return false;
+	}
+	std::vector<std::string_view> hosts;
+	std::vector<std::string_view> domainRules;
+	for (std::string_view rule : rules)
+	{
+		(isDomainRule(rule) ? domainRules : hosts).push_back(rule);
+	}
+	Blocklist blocklist(hosts, true, domainRules);
+	auto built = std::chrono::steady_clock::now();
+	if (!blocklist.save(indexPath)) {
+		std::cout << indexPath << " : cannot write file" << std::endl;
+		return false;
+	}
+
+	auto mapStart = std::chrono::steady_clock::now();
+	std::shared_ptr<const Blocklist> mapped = Blocklist::open(indexPath);
+	auto opened = std::chrono::steady_clock::now();
+	std::cout << blocklist.size() << " hosts, " << domainRules.size() << " wildcard and suffix rules, index "
+		<< blocklist.memoryBytes() / 1024 << " KiB" << std::endl;
+	std::cout << "parse + build : " << std::chrono::duration_cast<std::chrono::microseconds>(built - start).count() << " microseconds" << std::endl;
+	std::cout << "open index    : " << std::chrono::duration_cast<std::chrono::microseconds>(opened - mapStart).count() << " microseconds" << std::endl;
+	return mapped != nullptr;
+}
+
+/*
+ * RcuDomain
+ * read-copy-update grace periods: a reader announces the epoch it entered
+ * in its own slot, a writer bumps the epoch and waits until every slot is
+ * either idle or newer, after which no reader can still hold what the writer
+ * unpublished. Readers never lock nor touch a shared reference count
+ *  - one slot per reading thread, claimed on its first read and released
+ *    when the thread exits
+ *  - the slots come in segments of 64 chained without a lock; a segment is
+ *    appended when every slot is owned and never freed, so any number of
+ *    reader threads can enter
+ *  - read sections nest
+ */
+class RcuDomain {
+	struct Slot;
+	struct Reader;
+
+public:
+	class ReadSection {
+	public:
+		ReadSection() : reader(localReader())
+		{
+			if (reader.depth++ == 0) {
+				reader.slot->epoch.store(globalEpoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+			}
+		}
+
+		~ReadSection()
+		{
+			if (--reader.depth == 0) {
+				reader.slot->epoch.store(0, std::memory_order_release);
+			}
+		}
+
+		ReadSection(const ReadSection&) = delete;
+		ReadSection& operator=(const ReadSection&) = delete;
+
+	private:
+		Reader& reader;
+	};
+
+	// returns once every read section entered before the call has ended
+	static void synchronize()
+	{
+		const uint64_t epoch = globalEpoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+		for (Segment* segment = &firstSegment(); segment; segment = segment->next.load(std::memory_order_seq_cst))
+		{
+			for (Slot& slot : segment->slots)
+			{
+				for (uint64_t seen = slot.epoch.load(std::memory_order_seq_cst); seen != 0 && seen < epoch;
+					seen = slot.epoch.load(std::memory_order_seq_cst))
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+	}
+
+private:
+	struct alignas(64) Slot {
+		std::atomic<uint64_t> epoch{ 0 };		// 0 while the thread is outside any read section
+		std::atomic<bool> owned{ false };
+	};
+
+	struct Segment {
+		std::array<Slot, 64> slots;
+		std::atomic<Segment*> next{ nullptr };
+	};
+
+	struct Reader {
+		Slot* slot = nullptr;
+		size_t depth = 0;
+
+		~Reader()
+		{
+			if (slot) {
+				slot->owned.store(false, std::memory_order_release);
+			}
+		}
+	};
+
+	static Reader& localReader()
+	{
+		thread_local Reader reader;
+		if (!reader.slot) {
+			reader.slot = claimSlot();
+		}
+		return reader;
+	}
+
+	// a free slot, or one of a segment appended by this thread or a racing one
+	static Slot* claimSlot()
+	{
+		Segment* segment = &firstSegment();
+		while (true)
+		{
+			for (Slot& slot : segment->slots)
+			{
+				bool owned = false;
+				if (!slot.owned.load(std::memory_order_relaxed) && slot.owned.compare_exchange_strong(owned, true)) {
+					return &slot;
+				}
+			}
+			Segment* next = segment->next.load(std::memory_order_seq_cst);
+			if (!next) {
+				std::unique_ptr<Segment> appended = std::make_unique<Segment>();
+				if (segment->next.compare_exchange_strong(next, appended.get())) {
+					next = appended.release();
+				}
+			}
+			segment = next;
+		}
+	}
+
+	static Segment& firstSegment()
+	{
+		static Segment segment;
+		return segment;
+	}
+
+	static inline std::atomic<uint64_t> globalEpoch{ 1 };
+};
+
+/*
+ * RcuPointer
+ * a snapshot readers dereference inside an RcuDomain::ReadSection while
+ * writers swap it: in-flight readers keep the snapshot they loaded, new
+ * readers see the new one, and the old one is released after a grace period
+ */
+template <typename T>
+class RcuPointer {
+public:
+	explicit RcuPointer(std::shared_ptr<const T> initial) :
+		owner(std::move(initial)), current(owner.get()) {}
+
+	RcuPointer(const RcuPointer&) = delete;
+	RcuPointer& operator=(const RcuPointer&) = delete;
+
+	// only valid inside a read section
+	const T& get() const { return *current.load(std::memory_order_seq_cst); }
+
+	template <typename Function>
+	auto read(Function&& function) const
+	{
+		RcuDomain::ReadSection section;
+		return function(get());
+	}
+
+	// publishes value and returns the previous snapshot, which readers may
+	// still use until RcuDomain::synchronize() returns
+	std::shared_ptr<const T> publish(std::shared_ptr<const T> value)
+	{
+		std::lock_guard<std::mutex> lock(writerMutex);
+		current.store(value.get(), std::memory_order_seq_cst);
+		std::swap(owner, value);
+		return value;
+	}
+
+	// publishes value, runs afterPublish (e.g. to invalidate what was derived
+	// from the previous snapshot) and returns once no reader still uses it
+	template <typename Function>
+	void update(std::shared_ptr<const T> value, Function&& afterPublish)
+	{
+		std::shared_ptr<const T> retired = publish(std::move(value));
+		afterPublish();
+		RcuDomain::synchronize();
+	}
+
+private:
+	std::shared_ptr<const T> owner;
+	std::atomic<const T*> current;
+	mutable std::mutex writerMutex;
+};
+
+/*
+ * DecisionCache
+ * bounded allow/deny cache keyed by the raw serverHost string, so repeat
+ * requests skip host parsing and blocklist probing entirely
+ *  - a fixed table of 2-way sets, each slot a 128-byte seqlock: readers
+ *    never lock, a writer that finds a slot busy simply does not cache
+ *  - keys longer than maxKeyBytes are not cached
+ *  - every entry is stamped with the generation it was computed under:
+ *    invalidate() bumps the generation, which drops all entries at once
+ */
+class DecisionCache {
+public:
+	static constexpr size_t maxKeyBytes = 112;
+
+	struct Stats {
+		size_t hits;
+		size_t misses;
+	};
+
+	explicit DecisionCache(size_t slotCount = 1 << 16) :
+		slots(powerOfTwoAtLeast(std::max<size_t>(2, slotCount))) {}
+
+	uint32_t generation() const { return currentGeneration.load(std::memory_order_acquire); }
+
+	void invalidate() { currentGeneration.fetch_add(1, std::memory_order_acq_rel); }
+
+	std::optional<bool> find(std::string_view key)
+	{
+		if (key.size() <= maxKeyBytes) {
+			const uint64_t hash = hashKey(key);
+			const uint32_t expected = generation();
+			for (size_t way = 0; way < 2; way++)
+			{
+				std::optional<bool> allowed = read(slots[slotIndex(hash, way)], key, expected);
+				if (allowed) {
+					counters[stripe()].hits.fetch_add(1, std::memory_order_relaxed);
+					return allowed;
+				}
+			}
+		}
+		counters[stripe()].misses.fetch_add(1, std::memory_order_relaxed);
+		return std::nullopt;
+	}
+
+	// generation: the value of generation() read before the decision was computed
+	void insert(std::string_view key, bool allowed, uint32_t generation)
+	{
+		if (key.size() > maxKeyBytes) {
+			return;
+		}
+		const uint64_t hash = hashKey(key);
+		Slot& first = slots[slotIndex(hash, 0)];
+		Slot& second = slots[slotIndex(hash, 1)];
+		// prefer an empty or stale slot, otherwise let the hash pick the victim
+		Slot& victim = !isCurrent(first.meta.load(std::memory_order_relaxed), generation) ? first
+			: !isCurrent(second.meta.load(std::memory_order_relaxed), generation) ? second
+			: ((hash >> 63) ? second : first);
+		write(victim, key, allowed, generation);
+	}
+
+	Stats stats() const
+	{
+		Stats total{ 0, 0 };
+		for (const Counters& counter : counters)
+		{
+			total.hits += counter.hits.load(std::memory_order_relaxed);
+			total.misses += counter.misses.load(std::memory_order_relaxed);
+		}
+		return total;
+	}
+
+private:
+	static constexpr size_t keyWords = maxKeyBytes / sizeof(uint64_t);
+
+	struct alignas(64) Slot {
+		std::atomic<uint64_t> sequence{ 0 };	// odd while a writer owns the slot
+		std::atomic<uint64_t> meta{ 0 };		// generation << 32 | key length << 8 | valid << 1 | allowed
+		std::atomic<uint64_t> key[keyWords] = {};
+	};
+
+	// hit / miss counters striped per thread so they do not bounce one cache line
+	struct alignas(64) Counters {
+		std::atomic<size_t> hits{ 0 };
+		std::atomic<size_t> misses{ 0 };
+	};
+
+	static size_t powerOfTwoAtLeast(size_t value)
+	{
+		size_t power = 1;
+		while (power < value)
+		{
+			power *= 2;
+		}
+		return power;
+	}
+
+	// eight bytes per step: keys are compared in full, the hash only spreads them
+	static uint64_t hashKey(std::string_view key)
+	{
+		uint64_t hash = key.size() * 0x9E3779B97F4A7C15ull;
+		size_t i = 0;
+		for (; i + sizeof(uint64_t) <= key.size(); i += sizeof(uint64_t))
+		{
+			uint64_t word;
+			std::memcpy(&word, key.data() + i, sizeof(word));
+			hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+			hash ^= hash >> 32;
+		}
+		uint64_t tail = 0;
+		std::memcpy(&tail, key.data() + i, key.size() - i);
+		hash = (hash ^ tail) * 0xC4CEB9FE1A85EC53ull;
+		return hash ^ (hash >> 29);
+	}
+
+	static uint32_t metaGeneration(uint64_t meta) { return static_cast<uint32_t>(meta >> 32); }
+
+	static bool isCurrent(uint64_t meta, uint32_t generation) { return (meta & 2) && metaGeneration(meta) == generation; }
+
+	static size_t stripe()
+	{
+		static std::atomic<size_t> nextStripe{ 0 };
+		thread_local size_t index = nextStripe.fetch_add(1, std::memory_order_relaxed) % stripeCount;
+		return index;
+	}
+
+	size_t slotIndex(uint64_t hash, size_t way) const
+	{
+		return ((hash & (slots.size() - 1)) ^ way);
+	}
+
+	static std::optional<bool> read(const Slot& slot, std::string_view key, uint32_t generation)
+	{
+		const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+		if (before & 1) {
+			return std::nullopt;
+		}
+		const uint64_t meta = slot.meta.load(std::memory_order_relaxed);
+		if (!isCurrent(meta, generation) || ((meta >> 8) & 0xFF) != key.size()) {
+			return std::nullopt;
+		}
+		uint64_t words[keyWords];
+		const size_t wordCount = (key.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+		for (size_t i = 0; i < wordCount; i++)
+		{
+			words[i] = slot.key[i].load(std::memory_order_relaxed);
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) != before
+			|| std::memcmp(words, key.data(), key.size()) != 0) {
+			return std::nullopt;
+		}
+		return (meta & 1) != 0;
+	}
+
+	static void write(Slot& slot, std::string_view key, bool allowed, uint32_t generation)
+	{
+		uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+		if ((sequence & 1) || !slot.sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acquire)) {
+			return;	// another writer owns the slot
+		}
+		std::atomic_thread_fence(std::memory_order_release);
+		uint64_t words[keyWords] = {};
+		std::memcpy(words, key.data(), key.size());
+		const size_t wordCount = (key.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+		for (size_t i = 0; i < wordCount; i++)
+		{
+			slot.key[i].store(words[i], std::memory_order_relaxed);
+		}
+		slot.meta.store((static_cast<uint64_t>(generation) << 32) | (key.size() << 8) | 2 | (allowed ? 1 : 0), std::memory_order_relaxed);
+		slot.sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	static constexpr size_t stripeCount = 16;
+	std::vector<Slot> slots;
+	std::array<Counters, stripeCount> counters;
+	std::atomic<uint32_t> currentGeneration{ 0 };
+};
+
+/*
+ * LazyInternet  ==>  Virtual Proxy
+ * creates the expensive real subject on the first request that reaches it,
+ * and with an idle timeout tears it down once no request used it for that long
+ *  - requests find the subject in an RCU read section and pin it with a user
+ *    count, so they never lock once it exists
+ *  - creation (first request) and teardown (reaper thread) are serialized by
+ *    a mutex; a torn down subject is deleted when its last pin is released
+ */
+class LazyInternet : public Internet {
+public:
+	using Factory = std::function<std::unique_ptr<Internet>()>;
+
+	// idleTimeout zero: the subject is never torn down
+	explicit LazyInternet(Factory create, std::chrono::milliseconds idleTimeout = std::chrono::milliseconds::zero()) :
+		create(std::move(create)), idleTimeout(idleTimeout)
+	{
+		if (idleTimeout > std::chrono::milliseconds::zero()) {
+			reaper = std::thread(&LazyInternet::reap, this);
+		}
+	}
+
+	~LazyInternet()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		if (reaper.joinable()) {
+			reaper.join();
+		}
+		delete current.load();
+		for (Subject* subject : retired)
+		{
+			delete subject;
+		}
+	}
+
+	LazyInternet(const LazyInternet&) = delete;
+	LazyInternet& operator=(const LazyInternet&) = delete;
+
+	void connectTo(const std::string &serverHost) const override
+	{
+		Pin pin(acquire());
+		pin.subject->internet->connectTo(serverHost);
+	}
+
+	std::vector<bool> connectToBatch(const std::string* serverHosts, size_t count) const override
+	{
+		Pin pin(acquire());
+		return pin.subject->internet->connectToBatch(serverHosts, count);
+	}
+
+	bool isCreated() const { return current.load(std::memory_order_acquire) != nullptr; }
+
+	size_t creations() const { return createdCount.load(std::memory_order_relaxed); }
+
+	size_t teardowns() const { return tornDownCount.load(std::memory_order_relaxed); }
+
+private:
+	// in use while acquired != released; acquired only grows, so the reaper
+	// sees activity without the request path reading a clock
+	struct Subject {
+		std::unique_ptr<Internet> internet;
+		std::atomic<size_t> acquired{ 0 };
+		std::atomic<size_t> released{ 0 };
+	};
+
+	// releases the subject at the end of a request
+	struct Pin {
+		explicit Pin(Subject* subject) : subject(subject) {}
+		~Pin() { subject->released.fetch_add(1, std::memory_order_release); }
+		Pin(const Pin&) = delete;
+		Pin& operator=(const Pin&) = delete;
+
+		Subject* subject;
+	};
+
+	static bool isPinned(const Subject* subject)
+	{
+		return subject->released.load(std::memory_order_acquire) != subject->acquired.load(std::memory_order_acquire);
+	}
+
+	Subject* acquire() const
+	{
+		{
+			RcuDomain::ReadSection section;
+			if (Subject* subject = current.load(std::memory_order_seq_cst)) {
+				subject->acquired.fetch_add(1, std::memory_order_relaxed);
+				return subject;
+			}
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		Subject* subject = current.load(std::memory_order_relaxed);
+		if (!subject) {
+			subject = new Subject{ create(), {}, {} };
+			createdCount.fetch_add(1, std::memory_order_relaxed);
+			current.store(subject, std::memory_order_seq_cst);
+		}
+		subject->acquired.fetch_add(1, std::memory_order_relaxed);
+		return subject;
+	}
+
+	// reaper thread: once the subject saw no request for idleTimeout, unpublishes
+	// it, waits for a grace period so no request can still pin it, and deletes
+	// it when the pins are gone
+	void reap()
+	{
+		const auto tick = std::max(idleTimeout / 4, std::chrono::milliseconds(1));
+		const Subject* watched = nullptr;
+		size_t seenAcquired = 0;
+		auto idleSince = std::chrono::steady_clock::now();
+		std::unique_lock<std::mutex> lock(mutex);
+		while (!wake.wait_for(lock, tick, [this]() { return stopping; }))
+		{
+			Subject* subject = current.load(std::memory_order_relaxed);
+			const auto now = std::chrono::steady_clock::now();
+			if (subject && (subject != watched || subject->acquired.load(std::memory_order_relaxed) != seenAcquired)) {
+				watched = subject;
+				seenAcquired = subject->acquired.load(std::memory_order_relaxed);
+				idleSince = now;
+			}
+			else if (subject && !isPinned(subject) && now - idleSince >= idleTimeout) {
+				current.store(nullptr, std::memory_order_seq_cst);
+				RcuDomain::synchronize();
+				retired.push_back(subject);
+				watched = nullptr;
+				tornDownCount.fetch_add(1, std::memory_order_relaxed);
+			}
+			retired.erase(std::remove_if(retired.begin(), retired.end(), [](Subject* old) {
+				if (isPinned(old)) {
+					return false;
+				}
+				delete old;
+				return true;
+			}), retired.end());
+		}
+	}
+
+	Factory create;
+	std::chrono::milliseconds idleTimeout;
+	mutable std::atomic<Subject*> current{ nullptr };
+	mutable std::atomic<size_t> createdCount{ 0 };
+	std::atomic<size_t> tornDownCount{ 0 };
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+	std::vector<Subject*> retired;		// torn down, still pinned (reaper thread only)
+	std::thread reaper;
+};
+
+/*
+ * RateLimiter
+ * one token bucket per host: `rate` tokens per second, at most `burst` tokens
+ *  - a bucket is a single 64-bit atomic (last refill in ms | tokens, fixed
+ *    point) updated by compare-and-swap, refilled lazily on use
+ *  - the buckets sit in 256 shards of open-addressing tables read lock-free in
+ *    an RCU read section; a shard mutex is only taken to add a host
+ *  - a cleaner thread evicts buckets idle for idleTimeout (never shorter than
+ *    a full refill, so an evicted bucket was full and nothing is forgotten)
+ *    and frees them, and outgrown tables, after a grace period
+ */
+class RateLimiter {
+public:
+	struct Stats {
+		size_t buckets;
+		size_t evicted;
+	};
+
+	RateLimiter(double rate, double burst, std::chrono::milliseconds idleTimeout = std::chrono::seconds(60)) :
+		start(std::chrono::steady_clock::now())
+	{
+		if (rate <= 0 || burst < 1 || burst > 1e6) {
+			std::cout << "rate limiter: rate must be positive and burst within [1, 1e6]" << std::endl;
+			throw("rate limiter: invalid rate or burst");
+		}
+		unit = (uint64_t(1) << 32) / (static_cast<uint64_t>(burst) + 1);
+		capacity = static_cast<uint64_t>(burst * unit);
+		refillPerTick = std::max<uint64_t>(1, static_cast<uint64_t>(rate * unit / 1000));
+		fullRefillTicks = (capacity + refillPerTick - 1) / refillPerTick;
+		idleTicks = static_cast<uint32_t>(std::min<double>(INT32_MAX,	// compared as a signed tick difference
+			std::max<double>(static_cast<double>(idleTimeout.count()), std::ceil(1000 * burst / rate))));
+		for (Shard& shard : shards)
+		{
+			shard.table.store(new Table(minimumTableSize));
+		}
+		cleaner = std::thread(&RateLimiter::clean, this);
+	}
+
+	~RateLimiter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(cleanerMutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		cleaner.join();
+		for (Shard& shard : shards)
+		{
+			Table* table = shard.table.load();
+			for (size_t i = 0; i < table->size; i++)
+			{
+				Node* node = table->slots[i].load();
+				if (node && node != tombstone()) {
+					delete node;
+				}
+			}
+			delete table;
+			for (Table* retired : shard.retiredTables)
+			{
+				delete retired;
+			}
+		}
+	}
+
+	RateLimiter(const RateLimiter&) = delete;
+	RateLimiter& operator=(const RateLimiter&) = delete;
+
+	// takes one token from the bucket of host, false when it is empty
+	bool tryAcquire(std::string_view host)
+	{
+		const uint64_t hash = hashHost(host);
+		Shard& shard = shards[hash >> (64 - shardBits)];
+		const uint32_t now = tick();
+		{
+			RcuDomain::ReadSection section;
+			if (Node* node = find(*shard.table.load(std::memory_order_seq_cst), host, hash)) {
+				return consume(*node, now);
+			}
+		}
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		Node* node = find(*shard.table.load(std::memory_order_relaxed), host, hash);
+		if (!node) {
+			node = insert(shard, host, hash, now);
+		}
+		return consume(*node, now);
+	}
+
+	Stats stats() const
+	{
+		Stats stats{ 0, evictedCount.load(std::memory_order_relaxed) };
+		for (const Shard& shard : shards)
+		{
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			stats.buckets += shard.live;
+		}
+		return stats;
+	}
+
+private:
+	static constexpr size_t shardBits = 8;
+	static constexpr size_t minimumTableSize = 16;
+
+	struct Node {
+		std::string host;
+		uint64_t hash = 0;
+		std::atomic<uint64_t> state{ 0 };	// last refill tick << 32 | tokens (in `unit`s)
+	};
+
+	struct Table {
+		explicit Table(size_t size) : size(size), slots(new std::atomic<Node*>[size]()) {}
+
+		size_t size;	// power of two
+		std::unique_ptr<std::atomic<Node*>[]> slots;
+	};
+
+	struct alignas(64) Shard {
+		std::atomic<Table*> table{ nullptr };
+		mutable std::mutex mutex;			// guards the fields below and every store into the table
+		size_t live = 0;
+		size_t tombstones = 0;
+		std::vector<Table*> retiredTables;	// outgrown, freed by the cleaner
+	};
+
+	// marks an evicted slot, so the probe sequences running through it stay intact
+	static Node* tombstone()
+	{
+		static Node marker;
+		return &marker;
+	}
+
+	uint32_t tick() const
+	{
+		return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	static Node* find(const Table& table, std::string_view host, uint64_t hash)
+	{
+		for (size_t i = hash & (table.size - 1); ; i = (i + 1) & (table.size - 1))
+		{
+			Node* node = table.slots[i].load(std::memory_order_acquire);
+			if (!node) {
+				return nullptr;
+			}
+			if (node != tombstone() && node->hash == hash && node->host == host) {
+				return node;
+			}
+		}
+	}
+
+	bool consume(Node& node, uint32_t now) const
+	{
+		uint64_t state = node.state.load(std::memory_order_relaxed);
+		while (true)
+		{
+			const uint32_t last = static_cast<uint32_t>(state >> 32);
+			// another thread may have stored a later tick than the one read by this one
+			const uint32_t current = (static_cast<int32_t>(now - last) > 0) ? now : last;
+			const uint64_t elapsed = std::min<uint64_t>(current - last, fullRefillTicks);
+			const uint64_t tokens = std::min<uint64_t>(capacity, (state & 0xFFFFFFFFull) + elapsed * refillPerTick);
+			const bool granted = (tokens >= unit);
+			if (!granted && last == current) {
+				return false;
+			}
+			const uint64_t next = (uint64_t(current) << 32) | (granted ? tokens - unit : tokens);
+			if (node.state.compare_exchange_weak(state, next, std::memory_order_relaxed)) {
+				return granted;
+			}
+		}
+	}
+
+	// shard.mutex held
+	Node* insert(Shard& shard, std::string_view host, uint64_t hash, uint32_t now)
+	{
+		Table* table = shard.table.load(std::memory_order_relaxed);
+		if ((shard.live + shard.tombstones + 1) * 4 > table->size * 3) {
+			table = rebuild(shard, shard.live + 1);
+		}
+		Node* node = new Node;
+		node->host = std::string(host);
+		node->hash = hash;
+		node->state.store((uint64_t(now) << 32) | capacity, std::memory_order_relaxed);
+		size_t i = hash & (table->size - 1);
+		while (table->slots[i].load(std::memory_order_relaxed))
+		{
+			i = (i + 1) & (table->size - 1);
+		}
+		table->slots[i].store(node, std::memory_order_release);
+		shard.live++;
+		return node;
+	}
+
+	// shard.mutex held: publishes a table holding only the live nodes, sized
+	// for twice liveCount; the old table is retired to the cleaner
+	Table* rebuild(Shard& shard, size_t liveCount)
+	{
+		size_t size = minimumTableSize;
+		while (size < liveCount * 2)
+		{
+			size *= 2;
+		}
+		Table* old = shard.table.load(std::memory_order_relaxed);
+		Table* table = new Table(size);
+		for (size_t i = 0; i < old->size; i++)
+		{
+			Node* node = old->slots[i].load(std::memory_order_relaxed);
+			if (node && node != tombstone()) {
+				size_t j = node->hash & (size - 1);
+				while (table->slots[j].load(std::memory_order_relaxed))
+				{
+					j = (j + 1) & (size - 1);
+				}
+				table->slots[j].store(node, std::memory_order_relaxed);
+			}
+		}
+		shard.table.store(table, std::memory_order_seq_cst);
+		shard.tombstones = 0;
+		shard.retiredTables.push_back(old);
+		return table;
+	}
+
+	// cleaner thread: every half idleTimeout, unlinks the idle buckets, then
+	// frees them and the retired tables once no reader can still see them
+	void clean()
+	{
+		const auto period = std::chrono::milliseconds(std::max<uint32_t>(idleTicks / 2, 1));
+		std::unique_lock<std::mutex> lock(cleanerMutex);
+		while (!wake.wait_for(lock, period, [this]() { return stopping; }))
+		{
+			std::vector<Node*> nodes;
+			std::vector<Table*> tables;
+			const uint32_t now = tick();
+			for (Shard& shard : shards)
+			{
+				std::lock_guard<std::mutex> shardLock(shard.mutex);
+				Table* table = shard.table.load(std::memory_order_relaxed);
+				for (size_t i = 0; i < table->size; i++)
+				{
+					Node* node = table->slots[i].load(std::memory_order_relaxed);
+					// signed, like consume(): a bucket refilled after `now` was read is newer, not 4e9 ticks idle
+					if (node && node != tombstone()
+						&& static_cast<int32_t>(now - static_cast<uint32_t>(node->state.load(std::memory_order_relaxed) >> 32))
+							>= static_cast<int32_t>(idleTicks)) {
+						table->slots[i].store(tombstone(), std::memory_order_release);
+						nodes.push_back(node);
+						shard.live--;
+						shard.tombstones++;
+					}
+				}
+				if (shard.tombstones * 4 > table->size) {
+					rebuild(shard, shard.live);
+				}
+				tables.insert(tables.end(), shard.retiredTables.begin(), shard.retiredTables.end());
+				shard.retiredTables.clear();
+			}
+			if (!nodes.empty() || !tables.empty()) {
+				RcuDomain::synchronize();
+			}
+			for (Node* node : nodes)
+			{
+				delete node;
+			}
+			for (Table* table : tables)
+			{
+				delete table;
+			}
+			evictedCount.fetch_add(nodes.size(), std::memory_order_relaxed);
+		}
+	}
+
+	std::chrono::steady_clock::time_point start;
+	uint64_t unit = 0;			// one token
+	uint64_t capacity = 0;		// burst tokens
+	uint64_t refillPerTick = 0;	// per millisecond
+	uint64_t fullRefillTicks = 0;
+	uint32_t idleTicks = 0;
+	std::array<Shard, size_t(1) << shardBits> shards;
+	std::atomic<size_t> evictedCount{ 0 };
+	std::mutex cleanerMutex;
+	std::condition_variable wake;
+	bool stopping = false;
+	std::thread cleaner;
+};
+
+/*
+ * RateLimitedInternet  ==>  Proxy (protection)
+ * protects the downstream hosts: a request only reaches the wrapped subject
+ * while the token bucket of its host has a token left; ProxyInternet takes
+ * it as its real subject, so banned hosts are refused before any bucket is made
+ */
+class RateLimitedInternet : public Internet {
+public:
+	RateLimitedInternet(std::unique_ptr<Internet> internet, double requestsPerSecond, double burst,
+		std::chrono::milliseconds idleTimeout = std::chrono::seconds(60)) :
+		internet(std::move(internet)), limiter(requestsPerSecond, burst, idleTimeout) {}
+
+	void connectTo(const std::string &serverHost) const override
+	{
+		if (!limiter.tryAcquire(extractHost(serverHost))) {
+			std::cout << serverHost << " : Too Many Requests " << std::endl;
+			return;
+		}
+		internet->connectTo(serverHost);
+	}
+
+	std::vector<bool> connectToBatch(const std::string* serverHosts, size_t count) const override
+	{
+		std::vector<bool> admitted(count);
+		std::string refused;
+		for (size_t i = 0; i < count; i++)
+		{
+			admitted[i] = tryAcquire(serverHosts[i]);
+			if (!admitted[i]) {
+				refused += serverHosts[i] + " : Too Many Requests \n";
+			}
+		}
+		std::cout << refused << std::flush;
+		forwardAdmitted(*internet, serverHosts, admitted);
+		return admitted;
+	}
+
+	bool tryAcquire(const std::string &serverHost) const { return limiter.tryAcquire(extractHost(serverHost)); }
+
+	RateLimiter::Stats stats() const { return limiter.stats(); }
+
+private:
+	std::unique_ptr<Internet> internet;
+	mutable RateLimiter limiter;
+};
+
+#ifdef PROXY_POSIX_SOCKETS
+/*
+ * writeAll
+ * writes the whole buffer to a socket (no SIGPIPE when the peer is gone)
+ */
+bool writeAll(int socket, const char* data, size_t size)
+{
+#ifdef MSG_NOSIGNAL
+	const int flags = MSG_NOSIGNAL;
+#else
+	const int flags = 0;
+#endif
+	while (size != 0)
+	{
+		const ssize_t written = ::send(socket, data, size, flags);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+		if (written <= 0) {
+			return false;
+		}
+		data += written;
+		size -= static_cast<size_t>(written);
+	}
+	return true;
+}
+
+/*
+ * LoopbackEchoServer
+ * stand-in for the remote servers, so connections can be measured without
+ * any outside network: listens on 127.0.0.1 (ephemeral port) and echoes back
+ * whatever a client sends, on the same connection until the client closes it;
+ * one poll() loop serves every client
+ */
+class LoopbackEchoServer {
+public:
+	LoopbackEchoServer()
+	{
+		listener = ::socket(AF_INET, SOCK_STREAM, 0);
+		const int reuse = 1;
+		::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = 0;
+		socklen_t length = sizeof(address);
+		if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+			|| ::listen(listener, SOMAXCONN) != 0 || ::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) != 0
+			|| ::pipe(stopPipe) != 0) {
+			std::cout << "cannot listen on the loopback interface" << std::endl;
+			throw("cannot listen on the loopback interface");
+		}
+		listeningPort = ntohs(address.sin_port);
+		server = std::thread(&LoopbackEchoServer::serve, this);
+	}
+
+	~LoopbackEchoServer()
+	{
+		const char stop = 0;
+		if (::write(stopPipe[1], &stop, 1) == 1) {
+			server.join();
+		}
+		else {
+			server.detach();
+		}
+		::close(stopPipe[0]);
+		::close(stopPipe[1]);
+		::close(listener);
+	}
+
+	LoopbackEchoServer(const LoopbackEchoServer&) = delete;
+	LoopbackEchoServer& operator=(const LoopbackEchoServer&) = delete;
+
+	uint16_t port() const { return listeningPort; }
+
+private:
+	void serve()
+	{
+		std::vector<pollfd> watched = { { listener, POLLIN, 0 }, { stopPipe[0], POLLIN, 0 } };
+		char buffer[4096];
+		while (true)
+		{
+			if (::poll(watched.data(), watched.size(), -1) < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				break;
+			}
+			if (watched[1].revents != 0) {
+				break;
+			}
+			for (size_t i = 2; i < watched.size(); )
+			{
+				if (watched[i].revents != 0) {
+					const ssize_t received = ::read(watched[i].fd, buffer, sizeof(buffer));
+					if (received <= 0 || !writeAll(watched[i].fd, buffer, static_cast<size_t>(received))) {
+						::close(watched[i].fd);
+						watched[i] = watched.back();
+						watched.pop_back();
+						continue;
+					}
+				}
+				i++;
+			}
+			if (watched[0].revents & POLLIN) {
+				const int client = ::accept(listener, nullptr, nullptr);
+				if (client >= 0) {
+					watched.push_back({ client, POLLIN, 0 });
+				}
+			}
+		}
+		for (size_t i = 2; i < watched.size(); i++)
+		{
+			::close(watched[i].fd);
+		}
+	}
+
+	int listener = -1;
+	int stopPipe[2] = { -1, -1 };
+	uint16_t listeningPort = 0;
+	std::thread server;
 };
 
-/*
- * RealInternet  ==>  Real Subject
- * defines the real object that the proxy represents
- */
-class RealInternet : public Internet {
-public:
-	RealInternet() = default;
-	void connectTo(const std::string &serverHost) const override 
+/*
+ * PooledInternet  ==>  Proxy (smart reference)
+ * connection-management proxy: keeps up to maxIdlePerHost keep-alive
+ * connections per host and hands them to the next request for that host,
+ * instead of connecting and closing around every request
+ * (maxIdlePerHost 0: one connection per request); every host is routed to
+ * the loopback stand-in server listening on port
+ *  - the per-host pools are spread over shards, each with its own mutex
+ *  - a request whose pooled connection the server has closed is retried
+ *    once on a newly opened connection
+ */
+class PooledInternet : public Internet {
+public:
+	struct Stats {
+		size_t opened;
+		size_t reused;
+	};
+
+	explicit PooledInternet(uint16_t port, size_t maxIdlePerHost = 8) :
+		port(port), maxIdlePerHost(maxIdlePerHost) {}
+
+	~PooledInternet()
+	{
+		for (Shard& shard : shards)
+		{
+			for (auto& pool : shard.idle)
+			{
+				for (int connection : pool.second)
+				{
+					::close(connection);
+				}
+			}
+		}
+	}
+
+	PooledInternet(const PooledInternet&) = delete;
+	PooledInternet& operator=(const PooledInternet&) = delete;
+
+	void connectTo(const std::string &serverHost) const override
+	{
+		std::string response;
+		if (!request(serverHost, response)) {
+			std::cout << serverHost << " : connection failed" << std::endl;
+			throw("connection failed");
+		}
+	}
+
+	// one request / response round trip with the host of url
+	bool request(const std::string& url, std::string& response) const
+	{
+		const std::string host(extractHost(url));
+		const std::string message = "GET " + url + "\n";
+		int connection = checkout(host);
+		if (connection >= 0) {
+			if (roundTrip(connection, message, response)) {
+				checkin(host, connection);
+				return true;
+			}
+			// closed by the server while idle: the retry must not take another
+			// pooled connection, which may be just as stale
+			::close(connection);
+		}
+		connection = open();
+		if (connection < 0) {
+			return false;
+		}
+		if (!roundTrip(connection, message, response)) {
+			::close(connection);
+			return false;
+		}
+		checkin(host, connection);
+		return true;
+	}
+
+	Stats stats() const
+	{
+		return Stats{ openedCount.load(std::memory_order_relaxed), reusedCount.load(std::memory_order_relaxed) };
+	}
+
+private:
+	static constexpr size_t shardCount = 16;
+
+	struct Shard {
+		std::mutex mutex;
+		std::unordered_map<std::string, std::vector<int>> idle;
+	};
+
+	Shard& shardOf(const std::string& host) const { return shards[hashHost(host) % shardCount]; }
+
+	int checkout(const std::string& host) const
+	{
+		Shard& shard = shardOf(host);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		auto pool = shard.idle.find(host);
+		if (pool == shard.idle.end() || pool->second.empty()) {
+			return -1;
+		}
+		const int connection = pool->second.back();
+		pool->second.pop_back();
+		reusedCount.fetch_add(1, std::memory_order_relaxed);
+		return connection;
+	}
+
+	void checkin(const std::string& host, int connection) const
+	{
+		if (maxIdlePerHost != 0) {
+			Shard& shard = shardOf(host);
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			std::vector<int>& pool = shard.idle[host];
+			if (pool.size() < maxIdlePerHost) {
+				pool.push_back(connection);
+				return;
+			}
+		}
+		::close(connection);
+	}
+
+	int open() const
+	{
+		const int connection = ::socket(AF_INET, SOCK_STREAM, 0);
+		if (connection < 0) {
+			return -1;
+		}
+		const int enable = 1;
+		::setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+#ifdef SO_NOSIGPIPE
+		::setsockopt(connection, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+#endif
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = htons(port);
+		if (::connect(connection, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+			::close(connection);
+			return -1;
+		}
+		openedCount.fetch_add(1, std::memory_order_relaxed);
+		return connection;
+	}
+
+	// the reply is complete at its '\n', as every message is one line
+	static bool roundTrip(int connection, const std::string& message, std::string& response)
 	{
-		std::cout << "Connecting to " << serverHost << std::endl;
+		if (!writeAll(connection, message.data(), message.size())) {
+			return false;
+		}
+		response.clear();
+		char buffer[4096];
+		while (response.empty() || response.back() != '\n')
+		{
+			const ssize_t received = ::read(connection, buffer, sizeof(buffer));
+			if (received < 0 && errno == EINTR) {
+				continue;
+			}
+			if (received <= 0) {
+				return false;
+			}
+			response.append(buffer, static_cast<size_t>(received));
+		}
+		return true;
 	}
+
+	uint16_t port;
+	size_t maxIdlePerHost;
+	mutable std::array<Shard, shardCount> shards;
+	mutable std::atomic<size_t> openedCount{ 0 };
+	mutable std::atomic<size_t> reusedCount{ 0 };
 };
+#endif
 
 /*
  * ProxyInternet  ==>  Proxy
  * maintains a reference that lets the proxy access the real subject
+ * the host is pulled out by extractHost(), HostParser::Regex keeps
+ * the original std::regex_search path as the reference
+ * with enableDecisionCache(), repeat hosts are answered from a DecisionCache,
+ * which setBanList() invalidates
+ * the rules are an RcuPointer: setBanList() swaps them while requests are
+ * served, and the request path never takes a lock
+ * unless another real subject is given, the RealInternet sits behind a
+ * LazyInternet and is only created by the first allowed request
  */
 class ProxyInternet : public Internet {
 public:
-	ProxyInternet() : realInternet (std::make_unique<RealInternet>()){}
+	enum class HostParser { Fast, Regex };
+
+	explicit ProxyInternet(HostParser hostParser = HostParser::Fast) :
+		ProxyInternet(makeBanList({ "www.first.com" , "www.second.com" , "www.third.com" }), hostParser) {}
+
+	explicit ProxyInternet(std::shared_ptr<const BanList> bannedSite, HostParser hostParser = HostParser::Fast,
+		std::unique_ptr<Internet> realInternet = nullptr) :
+		bannedSite(std::move(bannedSite)), hostParser(hostParser),
+		realInternet(realInternet ? std::move(realInternet) : std::make_unique<LazyInternet>([]() { return std::make_unique<RealInternet>(); })) {}
 
 	void connectTo(const std::string &serverHost) const override 
 	{
-		std::smatch matches;
-		std::regex_search(serverHost, matches, urlRegex);
-		if (bannedSite.find(matches[3]) != bannedSite.end())
+		if (!isAllowed(serverHost))
 		{
 			// throw(" Access Denied ");
 			std::cout << serverHost << " : Access Denied "<<std::endl;
@@ -60,16 +2009,801 @@ public:
 		realInternet->connectTo(serverHost);
 	}
 
+	std::vector<bool> connectToBatch(const std::string* serverHosts, size_t count) const override
+	{
+		std::vector<bool> allowed = isAllowed(serverHosts, count);
+		std::string denied;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (!allowed[i]) {
+				denied += serverHosts[i] + " : Access Denied \n";
+			}
+		}
+		std::cout << denied << std::flush;
+		forwardAdmitted(*realInternet, serverHosts, allowed);
+		return allowed;
+	}
+
+	bool isAllowed(const std::string &serverHost) const
+	{
+		auto decideNow = [&](const BanList& banList) { return decide(serverHost, banList); };
+		if (!decisionCache) {
+			return bannedSite.read(decideNow);
+		}
+		if (std::optional<bool> allowed = decisionCache->find(serverHost)) {
+			return *allowed;
+		}
+		const uint32_t generation = decisionCache->generation();	// read before the rules, see setBanList()
+		const bool allowed = bannedSite.read(decideNow);
+		decisionCache->insert(serverHost, allowed, generation);
+		return allowed;
+	}
+
+	// batch check: one read section and one cache generation for the whole batch,
+	// hosts extracted and probed against the blocklist in chunks
+	std::vector<bool> isAllowed(const std::string* serverHosts, size_t count) const
+	{
+		constexpr size_t chunkSize = 256;
+		std::vector<bool> allowed(count);
+		const uint32_t generation = decisionCache ? decisionCache->generation() : 0;
+		RcuDomain::ReadSection section;
+		const BanList& banList = bannedSite.get();
+
+		std::string_view hosts[chunkSize];
+		size_t pending[chunkSize];
+		bool banned[chunkSize];
+		for (size_t begin = 0; begin < count; )
+		{
+			size_t size = 0;
+			for (; begin < count && size < chunkSize; begin++)
+			{
+				if (decisionCache) {
+					if (std::optional<bool> cached = decisionCache->find(serverHosts[begin])) {
+						allowed[begin] = *cached;
+						continue;
+					}
+				}
+				if (hostParser == HostParser::Regex) {
+					allowed[begin] = decide(serverHosts[begin], banList);
+					if (decisionCache) {
+						decisionCache->insert(serverHosts[begin], allowed[begin], generation);
+					}
+					continue;
+				}
+				hosts[size] = extractHost(serverHosts[begin]);
+				pending[size++] = begin;
+			}
+			banList.isBanned(hosts, size, banned);
+			for (size_t i = 0; i < size; i++)
+			{
+				allowed[pending[i]] = !banned[i];
+				if (decisionCache) {
+					decisionCache->insert(serverHosts[pending[i]], !banned[i], generation);
+				}
+			}
+		}
+		return allowed;
+	}
+
+	void enableDecisionCache(size_t slotCount = 1 << 16)
+	{
+		decisionCache = std::make_unique<DecisionCache>(slotCount);
+	}
+
+	DecisionCache::Stats cacheStats() const
+	{
+		return decisionCache ? decisionCache->stats() : DecisionCache::Stats{ 0, 0 };
+	}
+
+	// the new rules are published before the cache generation moves on, so
+	// a decision stamped with the new generation was made with the new rules;
+	// returns once no request still reads the previous rules
+	void setBanList(std::shared_ptr<const BanList> banList)
+	{
+		bannedSite.update(std::move(banList), [this] {
+			if (decisionCache) {
+				decisionCache->invalidate();
+			}
+		});
+	}
+
+	bool reloadBanList(const std::string& path)
+	{
+		std::shared_ptr<const BanList> banList = loadBanList(path);
+		if (!banList) {
+			return false;
+		}
+		setBanList(std::move(banList));
+		return true;
+	}
+
 private:
-	const std::set<std::string> bannedSite { "www.first.com" , "www.second.com" , "www.third.com" };
+	bool decide(const std::string &serverHost, const BanList& banList) const
+	{
+		if (hostParser == HostParser::Regex) {
+			std::smatch matches;
+			std::regex_search(serverHost, matches, urlRegex);
+			return !banList.isBanned(matches[3].str());
+		}
+		return !banList.isBanned(extractHost(serverHost));
+	}
+
+	RcuPointer<BanList> bannedSite;
+	std::unique_ptr<DecisionCache> decisionCache;
 	const std::regex urlRegex{ R"(((http|ftp|https):\/\/)?(([\w.-]*)\.([\w]*)))" };
-	std::unique_ptr<RealInternet> realInternet;
+	HostParser hostParser;
+	std::unique_ptr<Internet> realInternet;
+};
+
+/*
+ * benchmarkHostParser
+ * requests per second through ProxyInternet::isAllowed
+ * with the regex reference and with extractHost()
+ */
+void benchmarkHostParser()
+{
+	const std::vector<std::string> requests {
+		"www.first.com", "http://www.second.com", "http://www.google.com", "https://www.example.org/index.html",
+		"ftp://files.example.net:21/pub", "https://api.service.io/v1/users?id=42", "cdn-3.static.example.com/img.png",
+		"http://www.third.com/login" };
+	constexpr size_t requestCount = 2000000;
+
+	for (ProxyInternet::HostParser hostParser : { ProxyInternet::HostParser::Regex, ProxyInternet::HostParser::Fast })
+	{
+		ProxyInternet proxy(hostParser);
+		size_t allowed = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < requestCount; i++)
+		{
+			allowed += proxy.isAllowed(requests[i % requests.size()]);
+		}
+		auto stop = std::chrono::steady_clock::now();
+		const double seconds = std::chrono::duration<double>(stop - start).count();
+		std::cout << (hostParser == ProxyInternet::HostParser::Regex ? "std::regex   : " : "extractHost  : ")
+			<< static_cast<size_t>(requestCount / seconds) << " requests per second ("
+			<< allowed << " allowed)" << std::endl;
+	}
+}
+
+
+/*
+ * CountingAllocator
+ * std::allocator adding the bytes it allocates to a counter: the node
+ * footprint of the std::set baseline, without instrumenting the rest of
+ * the program
+ */
+template <typename T>
+struct CountingAllocator {
+	using value_type = T;
+
+	explicit CountingAllocator(size_t& bytes) : bytes(&bytes) {}
+
+	template <typename U>
+	CountingAllocator(const CountingAllocator<U>& other) : bytes(other.bytes) {}
+
+	T* allocate(size_t count)
+	{
+		*bytes += count * sizeof(T);
+		return std::allocator<T>().allocate(count);
+	}
+
+	void deallocate(T* memory, size_t count) { std::allocator<T>().deallocate(memory, count); }
+
+	template <typename U>
+	bool operator==(const CountingAllocator<U>& other) const { return bytes == other.bytes; }
+
+	template <typename U>
+	bool operator!=(const CountingAllocator<U>& other) const { return bytes != other.bytes; }
+
+	size_t* bytes;
+};
+
+/*
+ * randomHost
+ * "www." and 6 to 17 random letters under `domain`, the hosts the
+ * benchmarks ban and probe
+ */
+std::string randomHost(std::mt19937_64& generate, const char* domain)
+{
+	std::string host = "www.";
+	const size_t length = 6 + generate() % 12;
+	for (size_t i = 0; i < length; i++)
+	{
+		host += static_cast<char>('a' + generate() % 26);
+	}
+	return host + domain;
+}
+
+/*
+ * benchmarkBlocklist
+ * builds a blocklist of random hosts as the original std::set and as
+ * Blocklist (with and without Bloom filter), then compares footprint
+ * and lookup time on a mix of banned and allowed hosts
+ */
+void benchmarkBlocklist(size_t hostCount)
+{
+	std::mt19937_64 generate(2019);
+	constexpr const char* domains[] = { ".com", ".net", ".org", ".io", ".co.uk" };
+	std::vector<std::string> hosts(hostCount);
+	for (std::string& host : hosts)
+	{
+		host = randomHost(generate, domains[generate() % 5]);
+	}
+	std::vector<std::string> probes(1000000);
+	for (size_t i = 0; i < probes.size(); i++)
+	{
+		probes[i] = (i % 2 == 0) ? hosts[generate() % hostCount] : randomHost(generate, domains[generate() % 5]);	// half banned, half (almost surely) allowed
+	}
+
+	auto timeLookups = [&](auto&& contains) {
+		size_t found = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (const std::string& probe : probes)
+		{
+			found += contains(probe);
+		}
+		auto stop = std::chrono::steady_clock::now();
+		std::cout << std::chrono::duration<double, std::nano>(stop - start).count() / probes.size()
+			<< " ns per lookup (" << found << " banned)" << std::endl;
+	};
+
+	std::cout << hostCount << " banned hosts" << std::endl;
+	{
+		size_t bytes = 0;
+		std::set<std::string, std::less<>, CountingAllocator<std::string>> bannedSite(hosts.begin(), hosts.end(),
+			std::less<>(), CountingAllocator<std::string>(bytes));
+		for (const std::string& host : bannedSite)
+		{
+			const char* object = reinterpret_cast<const char*>(&host);
+			if (host.data() < object || host.data() >= object + sizeof(host)) {
+				bytes += host.capacity() + 1;	// heap buffer of a host longer than the small-string buffer
+			}
+		}
+		std::cout << "std::set          : " << bytes / (1 << 20) << " MiB, ";
+		timeLookups([&](const std::string& host) { return bannedSite.find(host) != bannedSite.end(); });
+	}
+	for (bool bloomFilter : { false, true })
+	{
+		Blocklist bannedSite(std::vector<std::string_view>(hosts.begin(), hosts.end()), bloomFilter);
+		std::cout << (bloomFilter ? "Blocklist + Bloom : " : "Blocklist         : ") << bannedSite.memoryBytes() / (1 << 20) << " MiB, ";
+		timeLookups([&](const std::string& host) { return bannedSite.contains(host); });
+	}
+}
+
+/*
+ * benchmarkDomainTrie
+ * ns per lookup of DomainTrie against a linear scan of the suffix rules,
+ * for growing rule counts (the trie stays flat, the scan grows)
+ */
+void benchmarkDomainTrie()
+{
+	std::mt19937_64 generate(2019);
+	auto randomLabel = [&]() {
+		std::string label;
+		const size_t length = 4 + generate() % 8;
+		for (size_t i = 0; i < length; i++)
+		{
+			label += static_cast<char>('a' + generate() % 26);
+		}
+		return label;
+	};
+
+	std::cout << std::setw(10) << "rules" << std::setw(16) << "trie ns" << std::setw(16) << "scan ns" << std::endl << std::fixed << std::setprecision(1);
+	for (size_t ruleCount = 1000; ruleCount <= 1000000; ruleCount *= 10)
+	{
+		std::vector<std::string> domains(ruleCount);
+		DomainTrie trie;
+		for (std::string& domain : domains)
+		{
+			domain = randomLabel() + ".com";
+			trie.addWildcard(domain);
+		}
+		std::vector<std::string> probes(100000);
+		for (size_t i = 0; i < probes.size(); i++)
+		{
+			const std::string& domain = (i % 2 == 0) ? domains[generate() % ruleCount] : randomLabel() + ".net";
+			probes[i] = "www." + randomLabel() + "." + domain;
+		}
+
+		size_t banned = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (const std::string& probe : probes)
+		{
+			banned += trie.matches(probe);
+		}
+		auto stop = std::chrono::steady_clock::now();
+		const double trieNs = std::chrono::duration<double, std::nano>(stop - start).count() / probes.size();
+
+		constexpr size_t scanProbes = 200;
+		start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < scanProbes; i++)
+		{
+			const std::string_view probe = probes[i];
+			banned += std::any_of(domains.begin(), domains.end(), [&](const std::string& domain) {
+				return probe.size() > domain.size() && probe[probe.size() - domain.size() - 1] == '.'
+					&& probe.substr(probe.size() - domain.size()) == domain;
+			});
+		}
+		stop = std::chrono::steady_clock::now();
+		const double scanNs = std::chrono::duration<double, std::nano>(stop - start).count() / scanProbes;
+		std::cout << std::setw(10) << ruleCount << std::setw(16) << trieNs << std::setw(16) << scanNs
+			<< "   (" << banned << " banned)" << std::endl;
+	}
+}
+
+/*
+ * benchmarkDecisionCache
+ * skewed traffic (a few hosts make most of the requests) through
+ * ProxyInternet against 1M banned hosts, without and with the cache
+ */
+void benchmarkDecisionCache()
+{
+	std::mt19937_64 generate(2019);
+	std::vector<std::string> banned(1000000);
+	for (std::string& host : banned)
+	{
+		host = randomHost(generate, ".com");
+	}
+	std::shared_ptr<const BanList> banList = makeBanList(std::vector<std::string_view>(banned.begin(), banned.end()));
+
+	// 100K distinct URLs, popularity ~ rank^-1.2
+	std::vector<std::string> urls(100000);
+	for (size_t i = 0; i < urls.size(); i++)
+	{
+		urls[i] = "https://" + ((i % 10 == 0) ? banned[generate() % banned.size()] : randomHost(generate, ".com")) + "/index.html";
+	}
+	std::vector<uint32_t> requests(4000000);
+	std::uniform_real_distribution<> uniform(0.0, 1.0);
+	for (uint32_t& request : requests)
+	{
+		request = static_cast<uint32_t>(std::min<double>(urls.size() - 1, std::pow(urls.size(), std::pow(uniform(generate), 2.2))) - 1);
+	}
+
+	const size_t threadCount = std::max(2u, std::thread::hardware_concurrency());
+	for (bool cached : { false, true })
+	{
+		for (size_t threads : { size_t(1), threadCount })
+		{
+			ProxyInternet proxy(banList);
+			if (cached) {
+				proxy.enableDecisionCache();
+			}
+			std::atomic<size_t> allowed{ 0 };
+			auto work = [&](size_t first, size_t last) {
+				size_t count = 0;
+				for (size_t i = first; i < last; i++)
+				{
+					count += proxy.isAllowed(urls[requests[i]]);
+				}
+				allowed += count;
+			};
+			auto start = std::chrono::steady_clock::now();
+			std::vector<std::thread> workers;
+			for (size_t t = 0; t < threads; t++)
+			{
+				workers.emplace_back(work, requests.size() * t / threads, requests.size() * (t + 1) / threads);
+			}
+			for (std::thread& worker : workers)
+			{
+				worker.join();
+			}
+			auto stop = std::chrono::steady_clock::now();
+			const double seconds = std::chrono::duration<double>(stop - start).count();
+			DecisionCache::Stats stats = proxy.cacheStats();
+			std::cout << (cached ? "decision cache, " : "no cache,       ") << std::setw(2) << threads << " threads : "
+				<< std::setw(10) << static_cast<size_t>(requests.size() / seconds) << " requests per second ("
+				<< allowed << " allowed, " << stats.hits << " hits, " << stats.misses << " misses)" << std::endl;
+		}
+	}
+}
+
+/*
+ * benchmarkReload
+ * reader threads keep checking URLs through ProxyInternet while a writer
+ * swaps two 1M host blocklists: reader throughput without and during
+ * reloads, and the latency of setBanList() (publish + grace period)
+ */
+void benchmarkReload()
+{
+	std::mt19937_64 generate(2019);
+	auto randomHosts = [&](size_t count) {
+		std::vector<std::string> hosts(count);
+		for (std::string& host : hosts)
+		{
+			host = randomHost(generate, ".com");
+		}
+		return hosts;
+	};
+	std::vector<std::string> first = randomHosts(1000000);
+	std::vector<std::string> second = randomHosts(1000000);
+	std::shared_ptr<const BanList> banLists[] = {
+		makeBanList(std::vector<std::string_view>(first.begin(), first.end())),
+		makeBanList(std::vector<std::string_view>(second.begin(), second.end())) };
+	std::vector<std::string> urls;
+	for (size_t i = 0; i < 100000; i++)
+	{
+		urls.push_back("https://" + ((i % 2) ? first[i] : second[i]) + "/index.html");
+	}
+
+	const size_t readerCount = std::max(2u, std::thread::hardware_concurrency());
+	ProxyInternet proxy(banLists[0]);
+	for (bool reloading : { false, true })
+	{
+		std::atomic<bool> stop{ false };
+		std::atomic<size_t> checked{ 0 };
+		std::vector<std::thread> readers;
+		for (size_t t = 0; t < readerCount; t++)
+		{
+			readers.emplace_back([&, t]() {
+				size_t count = 0;
+				for (size_t i = t * 7919; !stop.load(std::memory_order_relaxed); i++)
+				{
+					proxy.isAllowed(urls[i % urls.size()]);
+					count++;
+				}
+				checked += count;
+			});
+		}
+
+		std::vector<double> latencies;
+		auto start = std::chrono::steady_clock::now();
+		while (std::chrono::steady_clock::now() - start < std::chrono::seconds(2))
+		{
+			if (reloading) {
+				auto reloadStart = std::chrono::steady_clock::now();
+				proxy.setBanList(banLists[(latencies.size() + 1) % 2]);
+				latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - reloadStart).count());
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		stop = true;
+		for (std::thread& reader : readers)
+		{
+			reader.join();
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << (reloading ? "reloading every ms : " : "no reload          : ") << std::setw(10)
+			<< static_cast<size_t>(checked / seconds) << " requests per second (" << readerCount << " readers)";
+		if (reloading) {
+			std::sort(latencies.begin(), latencies.end());
+			std::cout << ", " << latencies.size() << " reloads, latency median " << std::fixed << std::setprecision(1)
+				<< latencies[latencies.size() / 2] << " us, max " << latencies.back() << " us";
+		}
+		std::cout << std::endl;
+	}
+}
+
+/*
+ * benchmarkBatch
+ * URLs per second checked one by one through isAllowed() and in batches
+ * through the batch isAllowed(), against 1M banned hosts
+ */
+void benchmarkBatch()
+{
+	std::mt19937_64 generate(2019);
+	std::vector<std::string> banned(1000000);
+	for (std::string& host : banned)
+	{
+		host = randomHost(generate, ".com");
+	}
+	for (bool bloomFilter : { false, true })
+	{
+		ProxyInternet proxy(std::make_shared<const BanList>(BanList{
+			std::make_shared<const Blocklist>(std::vector<std::string_view>(banned.begin(), banned.end()), bloomFilter), nullptr }));
+		std::vector<std::string> urls(1000000);
+		for (size_t i = 0; i < urls.size(); i++)
+		{
+			urls[i] = "https://" + ((i % 10 == 0) ? banned[generate() % banned.size()] : randomHost(generate, ".com")) + "/articles/" + std::to_string(i) + ".html";
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		size_t allowedOneByOne = 0;
+		for (const std::string& url : urls)
+		{
+			allowedOneByOne += proxy.isAllowed(url);
+		}
+		const double oneByOne = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		for (size_t batchSize : { 16, 1000 })
+		{
+			start = std::chrono::steady_clock::now();
+			size_t allowed = 0;
+			for (size_t first = 0; first < urls.size(); first += batchSize)
+			{
+				std::vector<bool> decisions = proxy.isAllowed(urls.data() + first, std::min(batchSize, urls.size() - first));
+				allowed += std::count(decisions.begin(), decisions.end(), true);
+			}
+			const double batched = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if (batchSize == 16) {
+				std::cout << (bloomFilter ? "with Bloom filter" : "without Bloom filter") << std::endl;
+				std::cout << "  one by one    : " << std::setw(10) << static_cast<size_t>(urls.size() / oneByOne) << " URLs per second (" << allowedOneByOne << " allowed)" << std::endl;
+			}
+			std::cout << "  batch of " << std::setw(4) << batchSize << " : " << std::setw(10) << static_cast<size_t>(urls.size() / batched)
+				<< " URLs per second (" << allowed << " allowed)" << std::endl;
+		}
+	}
+}
+
+/*
+ * benchmarkLazy
+ * a stand-in real subject that takes 20 ms to build (sockets, TLS contexts):
+ * startup cost eager against lazy when every request is blocked, per-request
+ * cost of going through LazyInternet, and idle teardown
+ */
+class ExpensiveInternet : public Internet {
+public:
+	ExpensiveInternet() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); }
+
+	void connectTo(const std::string &serverHost) const override
+	{
+		connections.fetch_add(serverHost.size() != 0, std::memory_order_relaxed);
+	}
+
+	static inline std::atomic<size_t> connections{ 0 };
 };
 
+void benchmarkLazy()
+{
+	auto makeExpensive = []() { return std::make_unique<ExpensiveInternet>(); };
+	const std::vector<std::string> blocked(1000, "http://www.first.com/index.html");
+	for (bool lazy : { false, true })
+	{
+		auto start = std::chrono::steady_clock::now();
+		ProxyInternet proxy(makeBanList({ "www.first.com" }), ProxyInternet::HostParser::Fast,
+			lazy ? std::unique_ptr<Internet>(std::make_unique<LazyInternet>(makeExpensive)) : makeExpensive());
+		for (const std::string& url : blocked)
+		{
+			proxy.isAllowed(url);
+		}
+		std::cout << (lazy ? "lazy  : " : "eager : ") << "startup + 1000 blocked requests "
+			<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+	}
+
+	const size_t requestCount = 4000000;
+	const std::string url = "http://www.google.com/";
+	const size_t threadCount = std::max(2u, std::thread::hardware_concurrency());
+	for (bool lazy : { false, true })
+	{
+		std::unique_ptr<Internet> subject = lazy ? std::unique_ptr<Internet>(std::make_unique<LazyInternet>(makeExpensive, std::chrono::milliseconds(50)))
+			: makeExpensive();
+		subject->connectTo(url);
+		for (size_t threads : { size_t(1), threadCount })
+		{
+			auto start = std::chrono::steady_clock::now();
+			std::vector<std::thread> workers;
+			for (size_t t = 0; t < threads; t++)
+			{
+				workers.emplace_back([&]() {
+					for (size_t i = 0; i < requestCount / threads; i++)
+					{
+						subject->connectTo(url);
+					}
+				});
+			}
+			for (std::thread& worker : workers)
+			{
+				worker.join();
+			}
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			std::cout << (lazy ? "through LazyInternet, " : "direct,               ") << std::setw(2) << threads << " threads : "
+				<< std::setw(6) << std::setprecision(1) << std::fixed << seconds * 1e9 / requestCount << " ns per request" << std::endl;
+		}
+	}
+
+	LazyInternet lazy(makeExpensive, std::chrono::milliseconds(50));
+	for (size_t burst = 0; burst < 3; burst++)
+	{
+		lazy.connectTo(url);
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	}
+	std::cout << "idle timeout 50 ms, 3 bursts 200 ms apart : " << lazy.creations() << " creations, "
+		<< lazy.teardowns() << " teardowns" << std::endl;
+}
+
+#ifdef PROXY_POSIX_SOCKETS
+/*
+ * benchmarkPool
+ * request / response round trips to the loopback echo server across 16 hosts,
+ * with keep-alive pooling and with one connection per request
+ */
+void benchmarkPool()
+{
+	LoopbackEchoServer server;
+	const size_t threadCount = 4;
+	const size_t requestsPerThread = 5000;
+	for (size_t maxIdlePerHost : { size_t(0), size_t(8) })
+	{
+		PooledInternet internet(server.port(), maxIdlePerHost);
+		std::vector<std::vector<double>> latencies(threadCount);
+		std::atomic<size_t> failures{ 0 };
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> clients;
+		for (size_t t = 0; t < threadCount; t++)
+		{
+			clients.emplace_back([&, t]() {
+				std::string response;
+				for (size_t i = 0; i < requestsPerThread; i++)
+				{
+					const std::string url = "http://www.host" + std::to_string((t + i) % 16) + ".com/index.html";
+					auto requestStart = std::chrono::steady_clock::now();
+					failures += !internet.request(url, response);
+					latencies[t].push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - requestStart).count());
+				}
+			});
+		}
+		for (std::thread& client : clients)
+		{
+			client.join();
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::vector<double> all;
+		for (const std::vector<double>& thread : latencies)
+		{
+			all.insert(all.end(), thread.begin(), thread.end());
+		}
+		std::sort(all.begin(), all.end());
+		PooledInternet::Stats stats = internet.stats();
+		std::cout << (maxIdlePerHost ? "keep-alive pool        : " : "connection per request : ")
+			<< std::setw(7) << static_cast<size_t>(all.size() / seconds) << " requests per second, latency p50 "
+			<< std::fixed << std::setprecision(1) << all[all.size() / 2] << " us, p99 " << all[all.size() * 99 / 100] << " us ("
+			<< stats.opened << " connections opened, " << stats.reused << " reused, " << failures << " failures)" << std::endl;
+	}
+}
+#endif
+
+/*
+ * benchmarkRateLimiter
+ * tryAcquire() per second from several threads, over 1 hot host (every thread
+ * on one bucket), 1K hosts and 200K hosts, against one mutex around an
+ * unordered_map of buckets; then idle eviction
+ */
+void benchmarkRateLimiter()
+{
+	struct GlobalLockLimiter {
+		double rate;
+		double burst;
+		std::mutex mutex;
+		std::unordered_map<std::string, std::pair<double, std::chrono::steady_clock::time_point>> buckets;
+
+		bool tryAcquire(const std::string& host)
+		{
+			const auto now = std::chrono::steady_clock::now();
+			std::lock_guard<std::mutex> lock(mutex);
+			auto found = buckets.find(host);
+			if (found == buckets.end()) {
+				found = buckets.emplace(host, std::make_pair(burst, now)).first;
+			}
+			auto& bucket = found->second;
+			bucket.first = std::min(burst, bucket.first + rate * std::chrono::duration<double>(now - bucket.second).count());
+			bucket.second = now;
+			if (bucket.first < 1) {
+				return false;
+			}
+			bucket.first -= 1;
+			return true;
+		}
+	};
+
+	const size_t threadCount = std::max(4u, std::thread::hardware_concurrency());
+	const size_t requestsPerThread = 1000000;
+	for (size_t hostCount : { size_t(1), size_t(1000), size_t(200000) })
+	{
+		std::vector<std::string> hosts(hostCount);
+		for (size_t i = 0; i < hostCount; i++)
+		{
+			hosts[i] = "www.host" + std::to_string(i) + ".com";
+		}
+		for (bool globalLock : { true, false })
+		{
+			RateLimiter limiter(1000, 100);
+			GlobalLockLimiter lockedLimiter{ 1000, 100, {}, {} };
+			std::atomic<size_t> granted{ 0 };
+			auto start = std::chrono::steady_clock::now();
+			std::vector<std::thread> workers;
+			for (size_t t = 0; t < threadCount; t++)
+			{
+				workers.emplace_back([&, t]() {
+					size_t count = 0;
+					for (size_t i = 0, host = t * 7919; i < requestsPerThread; i++, host += 13)
+					{
+						const std::string& name = hosts[host % hostCount];
+						count += globalLock ? lockedLimiter.tryAcquire(name) : limiter.tryAcquire(name);
+					}
+					granted += count;
+				});
+			}
+			for (std::thread& worker : workers)
+			{
+				worker.join();
+			}
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			std::cout << std::setw(6) << hostCount << " hosts, " << threadCount << " threads, "
+				<< (globalLock ? "global mutex + unordered_map : " : "RateLimiter                  : ")
+				<< std::setw(10) << static_cast<size_t>(threadCount * requestsPerThread / seconds) << " checks per second ("
+				<< granted << " granted)" << std::endl;
+		}
+	}
+
+	RateLimiter limiter(1000, 10, std::chrono::milliseconds(100));
+	for (size_t i = 0; i < 200000; i++)
+	{
+		limiter.tryAcquire("www.host" + std::to_string(i) + ".com");
+	}
+	RateLimiter::Stats before = limiter.stats();
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+	RateLimiter::Stats after = limiter.stats();
+	std::cout << "idle timeout 100 ms : " << before.buckets << " buckets, 300 ms later " << after.buckets
+		<< " (" << after.evicted << " evicted)" << std::endl;
+}
 
-int main()
+int main(int argc, char* argv[])
 {
+	if (argc > 1 && std::string(argv[1]) == "--bench-parser")
+	{
+		benchmarkHostParser();
+		return 0;
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench-blocklist")
+	{
+		benchmarkBlocklist(argc > 2 ? std::stoul(argv[2]) : 5000000);
+		return 0;
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench-ratelimit")
+	{
+		benchmarkRateLimiter();
+		return 0;
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench-pool")
+	{
+#ifdef PROXY_POSIX_SOCKETS
+		benchmarkPool();
+#else
+		std::cout << "--bench-pool needs POSIX sockets" << std::endl;
+#endif
+		return 0;
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench-lazy")
+	{
+		benchmarkLazy();
+		return 0;
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench-batch")
+	{
+		benchmarkBatch();
+		return 0;
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench-reload")
+	{
+		benchmarkReload();
+		return 0;
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench-cache")
+	{
+		benchmarkDecisionCache();
+		return 0;
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench-domains")
+	{
+		benchmarkDomainTrie();
+		return 0;
+	}
+	if (argc > 3 && std::string(argv[1]) == "--compile-blocklist")
+	{
+		return compileBlocklist(argv[2], argv[3]) ? 0 : 1;
+	}
+
 	std::unique_ptr<ProxyInternet> proxy = std::make_unique<ProxyInternet>();
+	if (argc > 2 && std::string(argv[1]) == "--blocklist")
+	{
+		std::shared_ptr<const BanList> bannedSite = loadBanList(argv[2]);
+		if (!bannedSite) {
+			std::cout << argv[2] << " : cannot open file" << std::endl;
+			return 1;
+		}
+		proxy = std::make_unique<ProxyInternet>(bannedSite);
+	}
 	proxy->connectTo("www.first.com");
 	proxy->connectTo("http://www.second.com");
 	proxy->connectTo("http://www.google.com");